@@ -6,8 +6,11 @@
 
 #include <iostream>
 #include <string>
-#include <sstream>
 #include <vector>
+
+#include "nngutil.h"
+
+using namespace nngutil;
 // Sample bus program.
 // -  Initializes nng
 // -  Open a bus.
@@ -33,28 +36,22 @@ std::vector<const char*> uris {
 /*
     Dial a URI in the bus.
 */
-static void dial(nng_socket s, const char* uri) {
-    int status;
-    if (status = nng_dial(s, uri, nullptr, 0)) {
-        std::cerr << "Failed to dial " << uri << " : " << nng_strerror(status) << std::endl;
-        exit(EXIT_FAILURE);
-    }
+static void dial(Socket& s, const char* uri) {
+    std::string doing = std::string("Failed to dial ") + uri;
+    s.dial(uri, doing.c_str());
 }
 /*
     setup the bus -listen on our URI and dial all others:
 */
 
-void setupBus(nng_socket s, int me) {
+void setupBus(Socket& s, int me) {
     // Now listen and then dial our URI:
-    int status;
 
     // start the listener.
 
     std::cout << me << " listening on " << uris[me] << std::endl;
-    if (status = nng_listen(s, uris[me], nullptr, 0)) {
-        std::cout << "Unable to listen on " << uris[me] << " : " << nng_strerror(status) << std::endl;
-        exit(EXIT_FAILURE);
-    }
+    std::string doing = std::string("Unable to listen on ") + uris[me];
+    s.listen(uris[me], doing.c_str());
     sleep(2);                         // Wait for them all to get going.
 
     // Set up the mesh. With the exception of the first and, last 'guy' we dial
@@ -90,79 +87,40 @@ void setupBus(nng_socket s, int me) {
    send the bus a message prefixed with our pid:
 */
 
-static void sendBusMsg(nng_socket s, int id, const char* msg) {
-    
-    nng_msg* pmsg;
-    int status;
+static void sendBusMsg(Socket& s, MessageBuilder& builder, int id, const char* msg) {
     
-    // Construct the message:
+    // Construct the message directly in the nng msg body:
 
-    std::stringstream strmsg;
-    strmsg << "ID: " << id << " " << msg;
+    Message busMsg = builder.format("ID: %d %s", id, msg);
+    std::cout << id << " sending message " << busMsg.str() << std::endl;
 
-    std::string msgString = strmsg.str();
-
-    // Allocate the nng msg and fill its body with msgString
-
-    if(status = nng_msg_alloc(&pmsg, msgString.size() + 1)) {
-        std::cerr << "Failed to allocate message: " << nng_strerror(status) << std::endl;
-        exit(EXIT_FAILURE);
-    }
-    if (status = nng_msg_insert(pmsg, msgString.c_str(), msgString.size()+1)) {
-        std::cerr << "Failed to fill message body: " << nng_strerror(status) << std::endl;
-        exit(EXIT_FAILURE);
-    }
-    std::cout << id << " sending message " << (char*)nng_msg_body(pmsg) << std::endl;
-    std::cout << "Should be " << msgString.c_str()  << std::endl;
-    // send the message and deallocate it:
-
-    if(status = nng_sendmsg(s, pmsg, 0)) {
-        std::cerr << "Failed to send the message: " << nng_strerror(status) << std::endl;
-        exit(EXIT_FAILURE);
-    }
-    // Free the message is done by nng_sendmsg
-
-    // nng_msg_free(pmsg);
-        
+    // send the message - nng_sendmsg takes care of freeing it:
 
+    s.send(std::move(busMsg), "Failed to send the message");
 }
-static void receiveBusMsgs(int me, nng_socket s) {
+static void receiveBusMsgs(int me, Socket& s) {
     while (1) {
-        nng_msg* pmsg;
-        int status;
-        
         // Recieve a message from the bus:
 
-        if (status = nng_recvmsg(s, &pmsg, 0)) {
-            std::cerr << "Failed to receive a message from the bus: " << nng_strerror(status) << std::endl;
-            exit(EXIT_FAILURE);
-        }
-
-        // Extract and output the string.
-
-        std::cout << "Got a message " << me << " : " << (char*)nng_msg_body(pmsg) << std::endl;
+        Message msg = s.recv("Failed to receive a message from the bus");
 
-        // Free the message for next time around.
+        // Extract and output the string.  The message is freed
+        // when msg goes out of scope.
 
-        nng_msg_free(pmsg);
+        std::cout << "Got a message " << me << " : " << msg.str() << std::endl;
     }
 }
 
 int main(int argc, char** argv) {
-    nng_socket s;
-    int status;
-
     int me = atoi(argv[1]);
-    if (status = nng_bus0_open(&s))  {
-        std::cerr << "Failed to opent he socket: " << nng_strerror(status) << std::endl;
-        exit(EXIT_FAILURE);
-    }
+    MessageBuilder builder;
+    Socket s(nng_bus0_open, "Failed to opent he socket");
 
 
     setupBus(s, me);
 
-    sendBusMsg(s, me, "Joined the bus");
-    sendBusMsg(s, me, "I'll send another");
+    sendBusMsg(s, builder, me, "Joined the bus");
+    sendBusMsg(s, builder, me, "I'll send another");
 
     receiveBusMsgs(me, s);
     nng_fini();
@@ -0,0 +1,204 @@
+// Implementation of the example helper library - see nngutil.h
+
+#include "nngutil.h"
+
+#include <iostream>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace nngutil {
+
+// Check the status of an nng call and exit with message on failure
+void
+checkstat(int status,  const char* doing) {
+    if (status) {
+        std::cerr << doing << ": " << nng_strerror(status) << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////
+// Message
+
+Message&
+Message::operator=(Message&& rhs) {
+    if (this != &rhs) {
+        if (m_pMsg) nng_msg_free(m_pMsg);
+        m_pMsg = rhs.release();
+    }
+    return *this;
+}
+
+Message::~Message() {
+    if (m_pMsg) nng_msg_free(m_pMsg);
+}
+
+// Give up ownership of the message - e.g. to nng_sendmsg.
+nng_msg*
+Message::release() {
+    nng_msg* result = m_pMsg;
+    m_pMsg = nullptr;
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Socket
+
+Socket::Socket(Opener open, const char* doing) : m_open(false) {
+    checkstat(open(&m_socket), doing);
+    m_open = true;
+}
+
+Socket::Socket(Socket&& rhs) : m_socket(rhs.m_socket), m_open(rhs.m_open) {
+    rhs.m_open = false;
+}
+
+Socket&
+Socket::operator=(Socket&& rhs) {
+    if (this != &rhs) {
+        close();
+        m_socket   = rhs.m_socket;
+        m_open     = rhs.m_open;
+        rhs.m_open = false;
+    }
+    return *this;
+}
+
+Socket::~Socket() {
+    close();
+}
+
+void
+Socket::listen(const char* uri, const char* doing) {
+    checkstat(nng_listen(m_socket, uri, nullptr, 0), doing);
+}
+
+void
+Socket::dial(const char* uri, const char* doing) {
+    checkstat(nng_dial(m_socket, uri, nullptr, 0), doing);
+}
+
+// nng_sendmsg takes ownership of the message on success.
+void
+Socket::send(Message&& msg, const char* doing) {
+    checkstat(nng_sendmsg(m_socket, msg.get(), 0), doing);
+    msg.release();
+}
+
+Message
+Socket::recv(const char* doing) {
+    nng_msg* pMsg;
+    checkstat(nng_recvmsg(m_socket, &pMsg, 0), doing);
+    return Message(pMsg);
+}
+
+// Receive returning the status rather than exiting on error
+// (e.g. NNG_ETIMEDOUT ends a survey).
+int
+Socket::recv(Message& msg, int flags) {
+    nng_msg* pMsg;
+    int status = nng_recvmsg(m_socket, &pMsg, flags);
+    if (status == 0) {
+        msg = Message(pMsg);
+    }
+    return status;
+}
+
+void
+Socket::close() {
+    if (m_open) {
+        nng_close(m_socket);
+        m_open = false;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////
+// MessageBuilder
+
+// capacity - initial body capacity of newly allocated messages.
+// poolSize - most messages kept for reuse.
+MessageBuilder::MessageBuilder(size_t capacity, size_t poolSize) :
+    m_capacity(capacity), m_poolSize(poolSize)
+{}
+
+MessageBuilder::~MessageBuilder() {
+    for (auto p : m_pool) {
+        nng_msg_free(p);
+    }
+}
+
+// Get a message with a len byte body - from the pool if possible.
+// Shrinking an nng_msg keeps its storage so a new message is allocated
+// with at least m_capacity and later messages that fit cost nothing.
+nng_msg*
+MessageBuilder::acquire(size_t len) {
+    nng_msg* pMsg;
+    if (!m_pool.empty()) {
+        pMsg = m_pool.back();
+        m_pool.pop_back();
+        nng_msg_clear(pMsg);
+        nng_msg_header_clear(pMsg);
+    } else {
+        checkstat(
+            nng_msg_alloc(&pMsg, len > m_capacity ? len : m_capacity),
+            "Failed to allocate message"
+        );
+    }
+    checkstat(nng_msg_realloc(pMsg, len), "Failed to size message");
+    return pMsg;
+}
+
+// printf into the body of a message.
+Message
+MessageBuilder::format(const char* fmt, ...) {
+    nng_msg* pMsg = acquire(m_capacity);
+    va_list args;
+
+    va_start(args, fmt);
+    int n = vsnprintf(static_cast<char*>(nng_msg_body(pMsg)), m_capacity, fmt, args);
+    va_end(args);
+
+    if (n < 0) {                       // Encoding error - nothing to send.
+        nng_msg_free(pMsg);
+        std::cerr << "Failed to format message: " << fmt << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    size_t len = static_cast<size_t>(n) + 1;
+    if (len > m_capacity) {            // Didn't fit - grow and do it again.
+        checkstat(nng_msg_realloc(pMsg, len), "Failed to grow message");
+        va_start(args, fmt);
+        vsnprintf(static_cast<char*>(nng_msg_body(pMsg)), len, fmt, args);
+        va_end(args);
+    }
+    checkstat(nng_msg_realloc(pMsg, len), "Failed to size message");
+    return Message(pMsg);
+}
+
+Message
+MessageBuilder::string(const char* str) {
+    return copy(str, strlen(str) + 1);
+}
+
+Message
+MessageBuilder::string(const std::string& str) {
+    return copy(str.c_str(), str.size() + 1);
+}
+
+Message
+MessageBuilder::copy(const void* data, size_t len) {
+    nng_msg* pMsg = acquire(len);
+    memcpy(nng_msg_body(pMsg), data, len);
+    return Message(pMsg);
+}
+
+// Take back a message whose contents are no longer needed.
+void
+MessageBuilder::recycle(Message&& msg) {
+    if (msg && (m_pool.size() < m_poolSize)) {
+        m_pool.push_back(msg.release());
+    }
+}
+
+}                    // namespace nngutil
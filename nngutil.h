@@ -0,0 +1,125 @@
+// Small helper library shared by the example programs.
+//
+//  checkstat      - check an nng status, report and exit on failure.
+//  Message        - move only owner of an nng_msg.
+//  Socket         - move only owner of an nng_socket.
+//  MessageBuilder - formats messages in place in pooled nng_msgs.
+//
+// Messages built here are sized exactly once; unlike
+// nng_msg_alloc(&p, n) + nng_msg_insert(p, data, n), which leaves a
+// 2n byte body and allocates twice, a message is allocated (or taken
+// from the pool) and the data written directly into its body.
+// Only recycled messages are pooled: a sent message belongs to nng, so
+// senders that never receive (push, publisher) get the single
+// allocation but no reuse.
+//
+#ifndef NNGUTIL_H
+#define NNGUTIL_H
+
+#include <nng/nng.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+namespace nngutil {
+
+// Check the status of an nng call and exit with message on failure
+
+void checkstat(int status, const char* doing);
+
+/**
+ * Message
+ *    Owns an nng_msg.  The message is freed on destruction unless
+ *  ownership has been given away with release() (e.g. by Socket::send).
+ */
+class Message {
+public:
+    Message() : m_pMsg(nullptr) {}
+    explicit Message(nng_msg* pMsg) : m_pMsg(pMsg) {}
+    Message(Message&& rhs) : m_pMsg(rhs.release()) {}
+    Message& operator=(Message&& rhs);
+    ~Message();
+
+    Message(const Message&) = delete;
+    Message& operator=(const Message&) = delete;
+
+    nng_msg* get() const { return m_pMsg; }
+    nng_msg* release();
+    explicit operator bool() const { return m_pMsg != nullptr; }
+
+    void*       body() const { return nng_msg_body(m_pMsg); }
+    size_t      len()  const { return nng_msg_len(m_pMsg); }
+    const char* str()  const { return static_cast<const char*>(body()); }
+
+private:
+    nng_msg* m_pMsg;
+};
+
+/**
+ * Socket
+ *    Owns an nng_socket which is closed on destruction.  Construct with
+ *  the protocol's open function e.g. Socket s(nng_pub0_open).
+ *  Converts to nng_socket so it can be passed to the rest of the nng API.
+ */
+class Socket {
+public:
+    typedef int (*Opener)(nng_socket*);
+
+    explicit Socket(Opener open, const char* doing = "Failed to open socket");
+    Socket(Socket&& rhs);
+    Socket& operator=(Socket&& rhs);
+    ~Socket();
+
+    Socket(const Socket&) = delete;
+    Socket& operator=(const Socket&) = delete;
+
+    operator nng_socket() const { return m_socket; }
+
+    void listen(const char* uri, const char* doing = "Failed to listen");
+    void dial(const char* uri, const char* doing = "Failed to dial");
+    void send(Message&& msg, const char* doing = "Failed to send message");
+    Message recv(const char* doing = "Failed to receive message");
+    int recv(Message& msg, int flags = 0);     // For callers that handle errors.
+    void close();
+
+private:
+    nng_socket m_socket;
+    bool       m_open;
+};
+
+/**
+ * MessageBuilder
+ *    Builds messages directly in the body of nng_msgs.  Messages whose
+ *  storage is no longer needed (e.g. received ones) can be recycled into
+ *  the builder's pool, where they keep their capacity for reuse.
+ *  Without recycle() every message built is a fresh nng_msg.
+ *  String messages include their null terminator as the examples expect.
+ *
+ * @note a builder is not thread safe - use one per thread.
+ */
+class MessageBuilder {
+public:
+    explicit MessageBuilder(size_t capacity = 256, size_t poolSize = 16);
+    ~MessageBuilder();
+
+    MessageBuilder(const MessageBuilder&) = delete;
+    MessageBuilder& operator=(const MessageBuilder&) = delete;
+
+    Message format(const char* fmt, ...)
+        __attribute__((format(printf, 2, 3)));
+    Message string(const char* str);
+    Message string(const std::string& str);
+    Message copy(const void* data, size_t len);
+    void recycle(Message&& msg);
+
+private:
+    nng_msg* acquire(size_t len);
+
+    size_t                m_capacity;
+    size_t                m_poolSize;
+    std::vector<nng_msg*> m_pool;
+};
+
+}                    // namespace nngutil
+
+#endif
@@ -16,22 +16,12 @@
 #include <nng/nng.h>
 #include <nng/protocol/pair0/pair.h>
 
-#include <string>
-#include <sstream>
-#include <iostream>
 #include <stdlib.h>
 #include <unistd.h>
 
+#include "nngutil.h"
 
-// too useful will need to be in a lib if we do this later.
-
-// Check the status of an nng call and exit with message on failure
-static void checkstat(int status,  const char* doing) {
-    if (status) {
-        std::cerr << doing << ": " << nng_strerror(status) << std::endl;
-        exit(EXIT_FAILURE);
-    }
-}
+using namespace nngutil;
 
 // Service the socket;
 //    Get a request.
@@ -40,61 +30,29 @@ static void checkstat(int status,  const char* doing) {
 //
 
 static void
-service(nng_socket s) {
-    nng_msg* preq;
-
-    // get the message:
+service(Socket& s, MessageBuilder& builder) {
+    // get the message and echo it back:
 
-    checkstat(
-        nng_recvmsg(s, &preq, 0), 
-        "Faield to get msg"
-    );
-    // echo back:
-
-    checkstat(
-        nng_sendmsg(s, preq, 0),
-        "Failed to echo"
-    );
+    s.send(s.recv("Faield to get msg"), "Failed to echo");
 
-    // preq is deleted by sendmsg.
+    // Fill in and send our unsolicited msg.
 
-    // Fill in our unsolicited msg.
-
-    std::stringstream strmsg;
-    strmsg << "My Pid, by the way is, " << getpid();
-    std::string msg(strmsg.str());
-    size_t len = msg.size() + 1;
-
-    checkstat(
-        nng_msg_alloc(&preq, len),
-        "Unable to allocate message"
-    );
-    checkstat(
-        nng_msg_insert(preq, msg.c_str(), len),
-        "Failed to encapsualate message"
-    );
-    checkstat(
-        nng_sendmsg(s, preq, 0),
+    s.send(
+        builder.format("My Pid, by the way is, %d", getpid()),
         "Failed to send unsolicited msg."
     );
 }
 
 int main(int argc, char** argv) {
-    nng_socket s;
     static const char* uri = argv[1];
+    MessageBuilder builder;
 
     // make a socket and listen on uri:
 
-    checkstat(
-        nng_pair0_open(&s),
-        "Failed to open the socket (pair0)"
-    );
-    checkstat(
-        nng_listen(s, uri, nullptr, 0),
-        "Failed to start listener "
-    );
+    Socket s(nng_pair0_open, "Failed to open the socket (pair0)");
+    s.listen(uri, "Failed to start listener ");
 
     while(1) {
-        service(s);                  // Service our peer.
+        service(s, builder);                  // Service our peer.
     }
 }
\ No newline at end of file
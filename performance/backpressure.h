@@ -0,0 +1,300 @@
+/**
+ * Backpressure profile of a sending socket.
+ *
+ * When receivers fall behind a push sender blocks and a pub sender
+ * drops, and neither leaves a trace.  BackpressureProfile::send wraps
+ * nng_send and, when enabled, records the time spent inside each send
+ * and how often NNG_OPT_SENDTIMEO expired (the send is then retried so
+ * the program behaves as before).  A sampler thread turns that into a
+ * profile over the run, one line per interval, alongside what nng's
+ * statistics say about the socket:
+ *
+ *   t(ms)       - time since the profile started.
+ *   sends/s     - completed sends.
+ *   timeouts    - SENDTIMEO expiries in the interval.
+ *   blocked%    - share of the interval spent inside nng_send, including
+ *                 the part so far of a send still blocked.
+ *   maxsend(ms) - longest single send in the interval (or the pending
+ *                 one so far, if longer).
+ *   pipes       - connected pipes.
+ *   queued      - messages accepted by nng_send but not yet handed to
+ *                 a transport (completed sends less the socket's
+ *                 tx_msgs statistic).  This is the queue building up
+ *                 in the socket and pipe send buffers.  For a
+ *                 broadcast socket (pub) every send is due once per
+ *                 pipe, so this counts copies queued or dropped.  "-" if
+ *                 nng was built without statistics.
+ *
+ * followed by a log2 histogram of the time spent in each send.
+ *
+ * Environment:
+ *   PERF_BACKPRESSURE=ms - enable, sampling every ms (100 if not a number).
+ *   PERF_SENDTIMEO=ms    - set NNG_OPT_SENDTIMEO on the socket.
+ * With PERF_BACKPRESSURE unset send is just nng_send.
+ *
+ * The time-in-send accounting is SendTimer, which faults uses as well.
+ */
+#ifndef BACKPRESSURE_H
+#define BACKPRESSURE_H
+
+#include <nng/nng.h>
+
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdlib.h>
+#include <time.h>
+
+#include "trace.h"
+#include "perfutil.h"
+
+/**
+ * SendTimer
+ *    Time spent inside sends, for a sampler in another thread.  Bracket
+ *  each send with begin/end; sample credits the time so far of a send
+ *  still pending to the current interval, so a send blocked on a stalled
+ *  receiver shows in the intervals it spans rather than all at once when
+ *  it returns.  The compare exchange in sample and the exchange in end
+ *  credit each nanosecond once.
+ */
+class SendTimer {
+public:
+    SendTimer() : m_sendNs(0), m_maxSendNs(0), m_begin(0), m_credit(0) {}
+    SendTimer(const SendTimer&) = delete;
+    SendTimer& operator=(const SendTimer&) = delete;
+
+    // A send is starting; returns its start time.
+    uint64_t begin() {
+        uint64_t t = now();
+        m_begin  = t;
+        m_credit = t;
+        return t;
+    }
+    // The send that began at start is done; returns how long it took.
+    uint64_t end(uint64_t start) {
+        uint64_t t    = now();
+        uint64_t from = m_credit.exchange(0);        // Less what sample credited.
+        m_begin = 0;
+        if (t > from) m_sendNs.fetch_add(t - from, std::memory_order_relaxed);
+
+        uint64_t took = t - start;
+        uint64_t max = m_maxSendNs.load(std::memory_order_relaxed);
+        while (took > max && !m_maxSendNs.compare_exchange_weak(max, took))
+            ;
+        return took;
+    }
+    /**
+     * sample
+     *    Called by the sampler at time t.
+     * @param sendNs[out]    - total time in sends so far.
+     * @param maxSendNs[out] - longest send since the last sample, counting
+     *                         the pending one so far.
+     */
+    void sample(uint64_t t, uint64_t& sendNs, uint64_t& maxSendNs) {
+        uint64_t from = m_credit;
+        if (from && from < t && m_credit.compare_exchange_strong(from, t)) {
+            m_sendNs.fetch_add(t - from, std::memory_order_relaxed);
+        }
+        uint64_t begin = m_begin;
+        uint64_t pending = (begin && begin < t) ? t - begin : 0;
+        sendNs    = m_sendNs;
+        maxSendNs = std::max(m_maxSendNs.exchange(0), pending);
+    }
+
+private:
+    std::atomic<uint64_t> m_sendNs;
+    std::atomic<uint64_t> m_maxSendNs;
+    std::atomic<uint64_t> m_begin;              // Pending send's start (0 - none).
+    std::atomic<uint64_t> m_credit;             // Its time from here isn't in m_sendNs.
+};
+
+class BackpressureProfile {
+public:
+    explicit BackpressureProfile(nng_socket s, bool broadcast = false) :
+        m_socket(s), m_broadcast(broadcast), m_enabled(false), m_intervalNs(0),
+        m_running(false), m_sends(0), m_timeouts(0) {
+        for (int i = 0; i < HISTOGRAM_BINS; i++) {
+            m_histogram[i] = 0;
+        }
+        const char* timeo = getenv("PERF_SENDTIMEO");
+        if (timeo) {
+            nng_setopt_ms(s, NNG_OPT_SENDTIMEO, atoi(timeo));
+        }
+        const char* enable = getenv("PERF_BACKPRESSURE");
+        if (enable) {
+            int ms = atoi(enable);
+            m_enabled    = true;
+            m_intervalNs = (uint64_t)(ms > 0 ? ms : 100) * 1000 * 1000;
+            m_running    = true;
+            m_sampler    = std::thread(&BackpressureProfile::sample, this);
+        }
+    }
+    ~BackpressureProfile() {
+        stop();
+    }
+    BackpressureProfile(const BackpressureProfile&) = delete;
+    BackpressureProfile& operator=(const BackpressureProfile&) = delete;
+
+    /**
+     * send
+     *    nng_send, accounted if enabled.  Sends that time out are retried.
+     *  Traced as "send" (see trace.h).
+     * @return int - nng status of the send.
+     */
+    int send(void* pData, size_t size, int flags = 0) {
+        TraceScope trace("send", traceNextSend());
+        if (!m_enabled) {
+            return nng_send(m_socket, pData, size, flags);
+        }
+        uint64_t start = m_timer.begin();
+        int status;
+        while ((status = nng_send(m_socket, pData, size, flags)) == NNG_ETIMEDOUT) {
+            m_timeouts.fetch_add(1, std::memory_order_relaxed);
+        }
+        uint64_t took = m_timer.end(start);
+
+        m_histogram[bin(took)].fetch_add(1, std::memory_order_relaxed);
+        if (status == 0) {
+            m_sends.fetch_add(1, std::memory_order_relaxed);
+        }
+        return status;
+    }
+
+    /**
+     * report
+     *    Stop sampling and print the profile (if enabled).
+     */
+    void report(std::ostream& out) {
+        if (!m_enabled) return;
+        stop();
+
+        out << "Backpressure profile:\n";
+        out << "t(ms)      sends/s  timeouts  blocked%  maxsend(ms)  pipes      queued\n";
+        for (auto& s : m_samples) {
+            out << std::setw(5) << s.t << " "
+                << std::fixed << std::setprecision(0) << std::setw(12) << s.rate << " "
+                << std::setw(9) << s.timeouts << " "
+                << std::setprecision(1) << std::setw(9) << s.blocked << " "
+                << std::setprecision(3) << std::setw(12) << s.maxSend << " "
+                << std::setw(6) << s.pipes << " ";
+            if (s.queued >= 0) {
+                out << std::setw(11) << s.queued << std::endl;
+            } else {
+                out << std::setw(11) << "-" << std::endl;
+            }
+        }
+        out << "Time in nng_send (us, < upper bound)  sends\n";
+        for (int i = 0; i < HISTOGRAM_BINS; i++) {
+            uint64_t n = m_histogram[i];
+            if (n) {
+                out << std::setw(20) << std::setprecision(3) << (double)(1ull << i)/1000.0
+                    << "  " << n << std::endl;
+            }
+        }
+        out << "SENDTIMEO expiries: " << m_timeouts << std::endl;
+    }
+
+private:
+    static const int HISTOGRAM_BINS = 64;
+
+    struct Sample {
+        uint64_t t;
+        double   rate;
+        uint64_t timeouts;
+        double   blocked;
+        double   maxSend;
+        uint64_t pipes;
+        int64_t  queued;                      // -1 if there are no stats.
+    };
+
+    static int bin(uint64_t ns) {
+        int b = 0;
+        while (b < HISTOGRAM_BINS - 1 && (1ull << b) <= ns) b++;
+        return b;
+    }
+
+    void stop() {
+        if (m_running) {
+            m_running = false;
+            m_sampler.join();
+        }
+    }
+
+    // nng's view of the socket: pipes and messages handed to transports.
+
+    bool socketStats(uint64_t& pipes, uint64_t& txMsgs) {
+        nng_stat* pRoot;
+        if (nng_stats_get(&pRoot)) return false;
+        bool found = false;
+        nng_stat* pSocket = nng_stat_find_socket(pRoot, m_socket);
+        if (pSocket) {
+            nng_stat* pPipes = nng_stat_find(pSocket, "pipes");
+            nng_stat* pTx    = nng_stat_find(pSocket, "tx_msgs");
+            if (pPipes && pTx) {
+                pipes  = nng_stat_value(pPipes);
+                txMsgs = nng_stat_value(pTx);
+                found  = true;
+            }
+        }
+        nng_stats_free(pRoot);
+        return found;
+    }
+
+    void sample() {
+        uint64_t start = now();
+        uint64_t next  = start;
+        uint64_t lastSends = 0, lastTimeouts = 0, lastSendNs = 0;
+        uint64_t txBase = 0;
+        uint64_t pipes = 0;
+        uint64_t due = 0;                    // Transmissions owed by sends so far.
+        bool     haveBase = socketStats(pipes, txBase);
+        while (m_running) {
+            next += m_intervalNs;
+            struct timespec t;
+            t.tv_sec  = next / 1000000000;
+            t.tv_nsec = next % 1000000000;
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, nullptr);
+
+            Sample s;
+            uint64_t sendNs, maxSendNs;
+            m_timer.sample(now(), sendNs, maxSendNs);
+            uint64_t sends = m_sends, timeouts = m_timeouts;
+            s.t        = (next - start)/1000000;
+            s.rate     = (sends - lastSends)*1.0e9/m_intervalNs;
+            s.timeouts = timeouts - lastTimeouts;
+            s.blocked  = 100.0*(sendNs - lastSendNs)/m_intervalNs;
+            s.maxSend  = maxSendNs/1.0e6;
+            uint64_t txMsgs;
+            due += (sends - lastSends) * (m_broadcast ? pipes : 1);
+            if (haveBase && socketStats(pipes, txMsgs)) {
+                s.pipes  = pipes;
+                s.queued = (int64_t)due - (int64_t)(txMsgs - txBase);
+            } else {
+                s.pipes  = 0;
+                s.queued = -1;
+            }
+            lastSends = sends;
+            lastTimeouts = timeouts;
+            lastSendNs = sendNs;
+            m_samples.push_back(s);
+        }
+    }
+
+    nng_socket            m_socket;
+    bool                  m_broadcast;
+    bool                  m_enabled;
+    uint64_t              m_intervalNs;
+    std::atomic<bool>     m_running;
+    std::thread           m_sampler;
+    std::vector<Sample>   m_samples;           // Sampler's until joined.
+    std::atomic<uint64_t> m_sends;
+    std::atomic<uint64_t> m_timeouts;
+    SendTimer             m_timer;
+    std::atomic<uint64_t> m_histogram[HISTOGRAM_BINS];
+};
+
+#endif
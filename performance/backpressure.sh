@@ -0,0 +1,22 @@
+#!/bin/bash
+
+# Backpressure profiles (see backpressure.h) of the push/pull pusher and
+# the pub/sub publisher, sampled every 100ms with a 10ms send timeout,
+# as the number of receivers grows.
+
+echo Backpressure log > backpressure.log
+
+export PERF_BACKPRESSURE=100
+export PERF_SENDTIMEO=10
+
+for n in 1 4 16
+do
+    for size in 100 65536
+    do
+	echo ---- push/pull $n pullers size $size -------- >> backpressure.log
+	echo | ./pushpull tcp://localhost:3000 200000 $size $n >> backpressure.log
+
+	echo ---- pub/sub $n subscribers size $size -------- >> backpressure.log
+	echo | ./pubsub tcp://localhost:3001 200000 $size $n >> backpressure.log
+    done
+done
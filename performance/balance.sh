@@ -0,0 +1,22 @@
+#!/bin/bash
+
+# Compare push/pull round robin (pushload) with the pull based
+# dispatcher (workreq) for equal and skewed worker speeds.
+#  Usage:  ./balance.sh [uri]
+
+uri=${1:-ipc:///tmp/balance}
+
+echo Load balance log > balance.log
+
+for skew in "0 100 100" "1 100 1000" "2 100 1000" "4 100 5000"
+do
+    set -- $skew
+    for workers in 4 8
+    do
+	echo ---- workers $workers slow $1 fastus $2 slowus $3 ---- >> balance.log
+	echo pushload >> balance.log
+	echo | ./pushload $uri 20000 1024 $workers $1 $2 $3 >> balance.log
+	echo workreq >> balance.log
+	echo | ./workreq $uri 20000 1024 $workers $1 $2 $3 2000 >> balance.log
+    done
+done
@@ -69,48 +69,13 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <vector>
-#include <stdio.h>   // Simplest way to construct names.
 
+#include "recvmode.h"
+#include "netns.h"
+#include "sendbuffer.h"
+#include "streams.h"            // constructEndpoints
+#include "perfutil.h"
 
-/**
- * checkstat
- *    Check the status of an nng call and output a message/exit
- * if the result is not ok.
- * 
- * @param status - nng status returned from a call.
- * @param doing  - text that will describe what failed.
- * 
- */
-static void 
-checkstat(int status,  const char* doing) {
-    if (status) {
-        std::cerr << doing << ": " << nng_strerror(status) << std::endl;
-        exit(EXIT_FAILURE);
-    }
-}
-
-
-/**
- * constructEndpoints
- *  Utility to construct the vector of services that will be used by the
- *  bus.
- * 
- * @param base  - bases endpoint name.
- * @param size  - Size of the bus.
- * @return std::vector<std::string>   - vector containing endpoint names 
- * @note this will be in order of participant number.
- */
-static std::vector<std::string>
-constructEndpoints(const char* base, size_t size) {
-    char endpoint[500];         // Should be big enough.
-    std::vector<std::string> result;
-
-    for (int i =0; i < size; i++) {
-        snprintf(endpoint, sizeof(endpoint), base, i);
-        result.push_back(std::string(endpoint));
-    }
-    return result;
-}
 
 /**
  * setupBus
@@ -127,7 +92,7 @@ static void
 setupBus(std::vector<std::string> uris, int me, nng_socket s) {
     // Start listening:
     checkstat(
-        nng_listen(s, uris[me].c_str(), nullptr, 0),
+        perfListen(s, uris[me].c_str(), nullptr, 0),
         "Bus member not able to listen"
     );
     // Wait for the bus to get populated;
@@ -194,6 +159,7 @@ receiver(
     void*  pMsg;
     size_t msgSize;
     std::vector<std::string> busUris = constructEndpoints(base.c_str(), size);
+    perfReceiverSetup();
 
     // Open the bus socket and set myself up on the bus:
 
@@ -210,7 +176,7 @@ receiver(
     
     while (lastseq < nmsg) {
         checkstat(
-            nng_recv(s, &pMsg, &msgSize, NNG_FLAG_ALLOC),
+            perfRecv(s, &pMsg, &msgSize),
             "Unable to receive a message from the bus."
         );
         uint32_t* pSeq = reinterpret_cast<uint32_t*>(pMsg);
@@ -229,7 +195,7 @@ receiver(
 
     bool done = false;
     while (!done) {
-        checkstat(nng_recv(s, &pMsg, &msgSize, NNG_FLAG_ALLOC),
+        checkstat(perfRecv(s, &pMsg, &msgSize),
             "Failed read for termination message."
         );
         uint32_t* pFlag = reinterpret_cast<uint32_t*>(pMsg);
@@ -290,7 +256,9 @@ int main(int argc, char** argv) {
 
     // The bus should be ready, start spraying messages to the reeciever(s):
 
-    uint8_t* message = new uint8_t[msgSize];
+    SendBuffer buffer(msgSize);
+    uint8_t* message = buffer.data();
+    TlbCounter tlb;
 
     auto start  = std::chrono::high_resolution_clock::now();
     int done = 0;         // _count_ of the done tasks. 
@@ -299,7 +267,7 @@ int main(int argc, char** argv) {
         uint32_t* msgseq = reinterpret_cast<uint32_t*>(message);
         *msgseq = seq++;
         checkstat(
-            nng_send(s, message, msgSize, 0),
+            tracedSend(s, message, msgSize, 0),
             "Failed to send message on the bus"
         );
         // Count the done tasks.
@@ -331,7 +299,7 @@ int main(int argc, char** argv) {
     uint32_t* pflag = reinterpret_cast<uint32_t*>(message);
     *pflag = 0xffffffff;       // Terminate flag
     checkstat(
-        nng_send(s, message, sizeof(uint32_t), 0),    // Just send the flag.
+        tracedSend(s, message, sizeof(uint32_t), 0),    // Just send the flag.
         "Failed to send terminate message\n"
     );
     std::cerr << "Joining threads\n";
@@ -351,7 +319,6 @@ int main(int argc, char** argv) {
         delete p;                  
     }
     receivers.clear();
-    delete  []message;
 
     // Compute and report the timngs::
 
@@ -365,6 +332,7 @@ int main(int argc, char** argv) {
     std::cout << "Time:       " << timing << std::endl;
     std::cout << "msgs/sec:   " << msgTiming << std::endl;
     std::cout << "KB/sec:     " << xferTiming/1024.0 << std::endl;
+    tlb.report(std::cout, buffer, seq);
 
     return EXIT_SUCCESS;
 }
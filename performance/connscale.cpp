@@ -0,0 +1,438 @@
+/**
+ *  This program measures connection setup at scale: N dialers all
+ * connecting to one listener at once, as happens when a run starts.
+ *
+ *   Usage:
+ *      connscale URI pattern ndialers [threads|procs]
+ *
+ *   Where:
+ *     URI      - is the URI the listener listens on.
+ *     pattern  - which pattern the listener speaks:
+ *                push   - listener pushes, dialers pull.
+ *                pub    - listener publishes, dialers subscribe.
+ *                bus    - listener and dialers are bus members.
+ *                survey - listener surveys, dialers are respondents.
+ *                req    - dialers request, listener replies.
+ *     ndialers - number of dialers (up to 10k or so - raise ulimit -n).
+ *     threads  - (default) each dialer is a thread in this process.
+ *     procs    - each dialer is a forked process.  Use this for the
+ *                listener's own memory and descriptor costs; in thread
+ *                mode those include the dialers' sockets.
+ *
+ *   The dialers are created first and block until released together.
+ *   Each then opens its socket and does a blocking nng_dial; if that fails
+ *   (e.g. the listen backlog overflowed) it is counted and the dial is
+ *   redone with NNG_FLAG_NONBLOCK so nng keeps retrying.  In req mode the
+ *   dialer then sends a request.  Each dialer reports (through a pipe, so
+ *   procs mode works the same way) when its dial returned and when its
+ *   first message arrived.
+ *
+ *   Meanwhile the listener counts pipes as they are added and sends:
+ *     push        - enough messages every millisecond to give each dialer
+ *                   that has not had one a chance.
+ *     pub/bus/survey - one message every millisecond.
+ *     req         - a reply to each request.
+ *   until every dialer has had a message.
+ *
+ *   Output (all times in ms from when the dialers were released):
+ *     - Blocking dial failures.
+ *     - Dial return time p50/p99/max.
+ *     - Time until the listener saw all N pipes.
+ *     - First message arrival p50/p99 and time until all had one.
+ *     - Listener process RSS growth and descriptors per pipe.
+ */
+#include <thread>
+#include <nng/nng.h>
+#include <nng/protocol/pipeline0/push.h>
+#include <nng/protocol/pipeline0/pull.h>
+#include <nng/protocol/pubsub0/pub.h>
+#include <nng/protocol/pubsub0/sub.h>
+#include <nng/protocol/bus0/bus.h>
+#include <nng/protocol/survey0/survey.h>
+#include <nng/protocol/survey0/respond.h>
+#include <nng/protocol/reqrep0/req.h>
+#include <nng/protocol/reqrep0/rep.h>
+
+#include <iostream>
+#include <fstream>
+#include <atomic>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "trace.h"
+#include "netns.h"
+#include "perfutil.h"
+
+
+/**
+ * fdCount
+ *   @return int - number of open file descriptors in this process.
+ */
+static int
+fdCount() {
+    int n = 0;
+    DIR* pDir = opendir("/proc/self/fd");
+    if (pDir) {
+        while (readdir(pDir)) n++;
+        closedir(pDir);
+    }
+    return n - 3;                        // ., .. and the directory itself.
+}
+
+enum Pattern {PUSH, PUB, BUS, SURVEY, REQ};
+
+/**
+ *  What each dialer reports.  Small enough that the write to the
+ *  results pipe is atomic.
+ */
+struct DialerResult {
+    uint64_t dialed;                     // When nng_dial returned.
+    uint64_t first;                      // When the first message arrived.
+    uint32_t dialFailed;                 // Nonzero if the blocking dial failed.
+};
+
+/**
+ * openDialer
+ *    Open the dialer's side of the pattern.
+ */
+static nng_socket
+openDialer(Pattern pattern) {
+    nng_socket s;
+    switch (pattern) {
+    case PUSH:
+        checkstat(nng_pull0_open(&s), "Unable to open a pull socket.");
+        break;
+    case PUB:
+        checkstat(nng_sub0_open(&s), "Unable to open a sub socket.");
+        checkstat(
+            nng_setopt(s, NNG_OPT_SUB_SUBSCRIBE, "", 0),
+            "Could not set subscription"
+        );
+        break;
+    case BUS:
+        checkstat(nng_bus0_open(&s), "Unable to open a bus socket.");
+        break;
+    case SURVEY:
+        checkstat(nng_respondent0_open(&s), "Unable to open a respondent socket.");
+        break;
+    case REQ:
+        checkstat(nng_req0_open(&s), "Unable to open a req socket.");
+        break;
+    }
+    return s;
+}
+
+/**
+ * openListener
+ *    Open the listener's side of the pattern.
+ */
+static nng_socket
+openListener(Pattern pattern) {
+    nng_socket s;
+    switch (pattern) {
+    case PUSH:
+        checkstat(nng_push0_open(&s), "Unable to open a push socket.");
+        break;
+    case PUB:
+        checkstat(nng_pub0_open(&s), "Unable to open a pub socket.");
+        break;
+    case BUS:
+        checkstat(nng_bus0_open(&s), "Unable to open a bus socket.");
+        break;
+    case SURVEY:
+        checkstat(nng_surveyor0_open(&s), "Unable to open a surveyor socket.");
+        break;
+    case REQ:
+        checkstat(nng_rep0_open(&s), "Unable to open a rep socket.");
+        break;
+    }
+    return s;
+}
+
+/**
+ * dialer
+ *    Wait to be released, connect, get one message, report and wait to
+ *  be told to close.
+ *
+ * @param uri      - listener URI.
+ * @param pattern  - which pattern.
+ * @param startFd  - read end of the start pipe (EOF means go).
+ * @param doneFd   - read end of the done pipe (EOF means close).
+ * @param resultFd - write end of the results pipe.
+ */
+static void
+dialer(std::string uri, Pattern pattern, int startFd, int doneFd, int resultFd) {
+    char c;
+    DialerResult result;
+    memset(&result, 0, sizeof(result));
+
+    read(startFd, &c, 1);
+
+    nng_socket s = openDialer(pattern);
+    if (nng_dial(s, uri.c_str(), nullptr, 0)) {
+        result.dialFailed = 1;
+        checkstat(
+            nng_dial(s, uri.c_str(), nullptr, NNG_FLAG_NONBLOCK),
+            "Could not start a background dial"
+        );
+    }
+    result.dialed = now();
+
+    if (pattern == REQ) {
+        char request[] = "HELLO";
+        checkstat(tracedSend(s, request, sizeof(request), 0), "Unable to send request");
+    }
+    void*  pMsg;
+    size_t size;
+    checkstat(
+        tracedRecv(s, &pMsg, &size, NNG_FLAG_ALLOC),
+        "Unable to receive the first message"
+    );
+    result.first = now();
+    nng_free(pMsg, size);
+
+    write(resultFd, &result, sizeof(result));
+    read(doneFd, &c, 1);
+    nng_close(s);
+}
+
+static std::atomic<size_t>   pipes(0);         // Pipes on the listener.
+static std::atomic<uint64_t> allPipesAt(0);    // When pipes reached ndialers.
+static size_t                ndialers;
+
+/**
+ * pipeEvent
+ *    Count the listener's pipes and note when they're all there.
+ */
+static void
+pipeEvent(nng_pipe p, nng_pipe_ev ev, void* arg) {
+    if (ev == NNG_PIPE_EV_ADD_POST) {
+        if (++pipes == ndialers) {
+            allPipesAt = now();
+        }
+    }
+}
+
+/**
+ * collect
+ *    Read the dialers' results as they come in.
+ *
+ * @param resultFd   - read end of the results pipe.
+ * @param pResults   - where they go.
+ * @param pCollected - count of results so far.
+ */
+static void
+collect(int resultFd, std::vector<DialerResult>* pResults, std::atomic<size_t>* pCollected) {
+    for (int i = 0; i < ndialers; i++) {
+        DialerResult result;
+        if (read(resultFd, &result, sizeof(result)) != sizeof(result)) {
+            std::cerr << "Lost a dialer result\n";
+            break;
+        }
+        pResults->push_back(result);
+        (*pCollected)++;
+    }
+}
+
+/**
+ * serve
+ *    Send to the dialers until they have all had a message.
+ *
+ * @param s          - listening socket.
+ * @param pattern    - which pattern.
+ * @param pCollected - number of dialers that have had a message.
+ */
+static void
+serve(nng_socket s, Pattern pattern, std::atomic<size_t>* pCollected) {
+    char message[] = "FIRST";
+    if (pattern == REQ) {
+        checkstat(
+            nng_setopt_ms(s, NNG_OPT_RECVTIMEO, 10),
+            "Unable to set receive timeout"
+        );
+        while (*pCollected < ndialers) {
+            void*  pReq;
+            size_t size;
+            int status = tracedRecv(s, &pReq, &size, NNG_FLAG_ALLOC);
+            if (status == NNG_ETIMEDOUT) continue;
+            checkstat(status, "Failed to receive a request");
+            nng_free(pReq, size);
+            checkstat(tracedSend(s, message, sizeof(message), 0), "Failed to reply");
+        }
+        return;
+    }
+    checkstat(
+        nng_setopt_ms(s, NNG_OPT_SENDTIMEO, 10),
+        "Unable to set send timeout"
+    );
+    while (*pCollected < ndialers) {
+        size_t nsend = (pattern == PUSH) ? ndialers - *pCollected : 1;
+        for (int i = 0; i < nsend; i++) {
+            int status = tracedSend(s, message, sizeof(message), 0);
+            if (status == NNG_ETIMEDOUT) break;      // No pipes yet.
+            checkstat(status, "Failed to send");
+        }
+        usleep(1000);
+    }
+}
+
+/**
+ * ms
+ *   @return double - milliseconds of ns since start.
+ */
+static double
+ms(uint64_t ns, uint64_t start) {
+    return ns > start ? (ns - start)/1.0e6 : 0.0;
+}
+
+/**
+ * percentileMs
+ *   @param sorted - sorted times (ns).
+ *   @param p      - percentile wanted [0, 100].
+ *   @param start  - time origin.
+ *   @return double - ms since start.
+ */
+static double
+percentileMs(const std::vector<uint64_t>& sorted, double p, uint64_t start) {
+    if (sorted.empty()) return 0.0;
+    return ms(sorted[percentileIndex(sorted.size(), p)], start);
+}
+
+/**
+ *  Entry point
+ * @note - this is not production code so missing command line
+ * parameters most likely result in a segfault.
+ */
+int main(int argc, char** argv) {
+    std::string uri(argv[1]);
+    std::string patternName(argv[2]);
+    ndialers = atol(argv[3]);
+    bool procs = (argc > 4) && (std::string(argv[4]) == "procs");
+
+    Pattern pattern;
+    if      (patternName == "push")   pattern = PUSH;
+    else if (patternName == "pub")    pattern = PUB;
+    else if (patternName == "bus")    pattern = BUS;
+    else if (patternName == "survey") pattern = SURVEY;
+    else if (patternName == "req")    pattern = REQ;
+    else {
+        std::cerr << "Unknown pattern " << patternName << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    int startPipe[2], donePipe[2], resultPipe[2];
+    if (pipe(startPipe) || pipe(donePipe) || pipe(resultPipe)) {
+        perror("Unable to make pipes");
+        exit(EXIT_FAILURE);
+    }
+
+    // Fork the dialer processes before nng is used at all in this
+    // process - nng's threads don't survive a fork.
+
+    std::vector<pid_t>        children;
+    std::vector<std::thread*> threads;
+    if (procs) {
+        for (int i = 0; i < ndialers; i++) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                close(startPipe[1]);
+                close(donePipe[1]);
+                close(resultPipe[0]);
+                dialer(uri, pattern, startPipe[0], donePipe[0], resultPipe[1]);
+                _exit(EXIT_SUCCESS);
+            }
+            if (pid < 0) {
+                perror("fork failed");
+                exit(EXIT_FAILURE);
+            }
+            children.push_back(pid);
+        }
+        close(resultPipe[1]);
+    }
+
+    long rssBefore = rssKB();
+    int  fdsBefore = fdCount();
+
+    nng_socket s = openListener(pattern);
+    checkstat(
+        nng_pipe_notify(s, NNG_PIPE_EV_ADD_POST, pipeEvent, nullptr),
+        "Failed to register for pipe additions"
+    );
+    checkstat(
+        perfListen(s, uri.c_str(), nullptr, 0),
+        "Listener could not start listening"
+    );
+    if (!procs) {
+        for (int i = 0; i < ndialers; i++) {
+            threads.push_back(new std::thread(
+                dialer, uri, pattern, startPipe[0], donePipe[0], resultPipe[1]
+            ));
+        }
+        sleep(1);                         // Let them all block on the start pipe.
+    }
+
+    std::vector<DialerResult> results;
+    std::atomic<size_t> collected(0);
+    results.reserve(ndialers);
+    std::thread collector(collect, resultPipe[0], &results, &collected);
+
+    // Release the dialers and serve until they've all had a message:
+
+    uint64_t start = now();
+    close(startPipe[1]);
+    serve(s, pattern, &collected);
+    uint64_t allDelivered = now();
+    collector.join();
+
+    long rssAfter = rssKB();
+    int  fdsAfter = fdCount();
+    size_t npipes = pipes;
+
+    // Let the dialers go:
+
+    close(donePipe[1]);
+    for (auto pid : children) {
+        waitpid(pid, nullptr, 0);
+    }
+    for (auto p : threads) {
+        p->join();
+        delete p;
+    }
+    nng_close(s);
+
+    std::vector<uint64_t> dialed, first;
+    size_t dialFailures = 0;
+    for (auto& r : results) {
+        dialed.push_back(r.dialed);
+        first.push_back(r.first);
+        dialFailures += r.dialFailed;
+    }
+    std::sort(dialed.begin(), dialed.end());
+    std::sort(first.begin(), first.end());
+
+    std::cout << patternName << ": " << ndialers << " dialers ("
+              << (procs ? "processes" : "threads") << ")\n";
+    std::cout << "Blocking dial failures:     " << dialFailures << std::endl;
+    std::cout << "Dial returned (ms) p50:     " << percentileMs(dialed, 50.0, start) << std::endl;
+    std::cout << "Dial returned (ms) p99:     " << percentileMs(dialed, 99.0, start) << std::endl;
+    std::cout << "Dial returned (ms) max:     " << percentileMs(dialed, 100.0, start) << std::endl;
+    std::cout << "All pipes up (ms):          " << ms(allPipesAt, start) << std::endl;
+    std::cout << "First message (ms) p50:     " << percentileMs(first, 50.0, start) << std::endl;
+    std::cout << "First message (ms) p99:     " << percentileMs(first, 99.0, start) << std::endl;
+    std::cout << "First message to all (ms):  " << ms(allDelivered, start) << std::endl;
+    std::cout << "Listener pipes:             " << npipes << std::endl;
+    std::cout << "RSS growth (KB):            " << rssAfter - rssBefore << std::endl;
+    std::cout << "RSS KB/pipe:                " << (npipes ? (double)(rssAfter - rssBefore)/npipes : 0.0) << std::endl;
+    std::cout << "Descriptors added:          " << fdsAfter - fdsBefore << std::endl;
+    std::cout << "Descriptors/pipe:           " << (npipes ? (double)(fdsAfter - fdsBefore)/npipes : 0.0) << std::endl;
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,20 @@
+#!/bin/bash
+
+# Connection setup at scale for each pattern.  Processes mode isolates
+# the listener's memory and descriptor cost per pipe.
+
+ulimit -n 40000
+
+echo Connection scale log > connscale.log
+
+for n in 100 1000 5000 10000
+do
+    for pattern in push pub bus survey req
+    do
+	for mode in threads procs
+	do
+	    echo ---- $pattern $n $mode -------- >> connscale.log
+	    ./connscale tcp://localhost:3000 $pattern $n $mode >> connscale.log
+	done
+    done
+done
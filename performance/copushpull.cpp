@@ -0,0 +1,263 @@
+/**
+ *  This program compares thread per socket pullers with coroutine
+ * pullers (coro.h) when there are many of them.
+ *   Usage:
+ *      copushpull URI nmsgs size npullers mode [nexec]
+ *
+ *   Where:
+ *     URI      - is the URI used to communicate.
+ *     nmsgs    - is the number of messages that will be sent.
+ *     size     - is the size of each message in bytes (at least 16).
+ *     npullers - is the number of pull sockets (hundreds is the point).
+ *     mode     - threads - each puller is a thread doing blocking receives
+ *                          as in pushpull.
+ *                coro    - each puller is a coroutine doing co_await
+ *                          receives on an Executor.
+ *     nexec    - number of executor threads in coro mode (default 2).
+ *
+ *   As in pushload each message carries the steady clock time at which it
+ *   was sent (after the first 8 bytes) and the pullers count what they get
+ *   into a shared counter rather than relying on end messages.  When the
+ *   counter reaches nmsgs the timing stops; threads notice a flag on their
+ *   receive timeout, coroutines get NNG_ECLOSED when their sockets are
+ *   closed.
+ *
+ *   Output:
+ *     - Time, msgs/sec, KB/sec as for pushpull.
+ *     - Latency percentiles from send to receipt.
+ *     - Threads in the process while the pullers run and peak RSS so the
+ *       memory cost of the two models can be compared.
+ */
+#include <thread>
+#include <nng/nng.h>
+#include <nng/protocol/pipeline0/push.h>
+#include <nng/protocol/pipeline0/pull.h>
+
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <atomic>
+#include <latch>
+#include <algorithm>
+#include <string>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <vector>
+
+#include "recvmode.h"
+#include "netns.h"
+#include "coro.h"
+#include "perfutil.h"
+
+
+static std::atomic<size_t> received(0);     // Total data messages pulled.
+static std::atomic<bool>   finished(false); // Threads can exit.
+
+/**
+ * openPuller
+ *    Make a pull socket dialed to the pusher.
+ */
+static nng_socket
+openPuller(const std::string& uri) {
+    nng_socket s;
+    checkstat(
+        nng_pull0_open(&s),
+        "Unable to open a pull socket."
+    );
+    checkstat(
+        nng_setopt_ms(s, NNG_OPT_RECVTIMEO, 100),
+        "Unable to set puller receive timeout"
+    );
+    checkstat(
+        nng_dial(s, uri.c_str(), nullptr, 0),
+        "Puller dial failed"
+    );
+    return s;
+}
+
+/**
+ * latencyOf
+ *   @return uint64_t - ns since the timestamp in a message body.
+ */
+static uint64_t
+latencyOf(const void* pBody) {
+    uint64_t sent;
+    memcpy(&sent, reinterpret_cast<const uint8_t*>(pBody) + sizeof(uint64_t), sizeof(sent));
+    return now() - sent;
+}
+
+/**
+ * threadPuller
+ *    Thread per socket puller.
+ *
+ * @param s           - dialed pull socket.
+ * @param pLatencies[out] - latency of each message we get (ns).
+ */
+static void
+threadPuller(nng_socket s, std::vector<uint64_t>* pLatencies) {
+    void*  pMsg;
+    size_t rcvsize;
+    perfReceiverSetup();
+
+    while (true) {
+        int status = perfRecv(s, &pMsg, &rcvsize);
+        if (status == NNG_ETIMEDOUT) {
+            if (finished) break;
+            continue;
+        }
+        checkstat(status, "Pull of data failed.");
+        pLatencies->push_back(latencyOf(pMsg));
+        nng_free(pMsg, rcvsize);
+        received++;
+    }
+}
+
+/**
+ * coPuller
+ *    Coroutine puller.  Runs until its socket is closed.
+ *
+ * @param executor    - where we are resumed.
+ * @param s           - dialed pull socket.
+ * @param pLatencies[out] - latency of each message we get (ns).
+ * @param pDone       - counted down when we exit.
+ */
+static Task
+coPuller(Executor& executor, nng_socket s, std::vector<uint64_t>* pLatencies, std::latch* pDone) {
+    CoSocket cs(executor, s);
+    cs.setTimeout(NNG_DURATION_INFINITE);     // Not the threads' RECVTIMEO.
+    while (true) {
+        nng_msg* pMsg;
+        int status = co_await cs.recv(&pMsg);
+        if (status == NNG_ECLOSED) break;
+        checkstat(status, "Pull of data failed.");
+        pLatencies->push_back(latencyOf(nng_msg_body(pMsg)));
+        nng_msg_free(pMsg);
+        received++;
+    }
+    pDone->count_down();
+}
+
+/**
+ *  pusher
+ *     Push timestamped messages to the pullers.
+ *
+ * @param s - socket on which to push  - must be listening.
+ * @param nmsg - Number of messages.
+ * @param msgSize - size of the messages
+ */
+static void
+pusher(nng_socket s, size_t nmsg, size_t msgSize) {
+    uint8_t* pMessage = new uint8_t[msgSize];
+    memset(pMessage, 0, msgSize);
+
+    for (int i = 0; i < nmsg; i++) {
+        uint64_t stamp = now();
+        memcpy(pMessage + sizeof(uint64_t), &stamp, sizeof(stamp));
+        checkstat(
+            tracedSend(s, pMessage, msgSize, 0),
+            "Failed to push a messages"
+        );
+    }
+    delete []pMessage;
+}
+
+/**
+ *  Entry point:
+ *
+ * @note
+ *    This is not production code so segfaults will likely happen
+ * if paramteers are missing.  See Usage at the start of the file.
+ */
+int main(int argc, char** argv) {
+    std::string uri(argv[1]);
+    const size_t nmsg(atoi(argv[2]));
+    size_t msgSize(atoi(argv[3]));
+    const size_t npullers(atoi(argv[4]));
+    bool coro = std::string(argv[5]) == "coro";
+    size_t nexec = (argc > 6) ? atoi(argv[6]) : 2;
+    nng_socket s;
+    std::vector<nng_socket> pullSockets;
+    std::vector<std::vector<uint64_t>> latencies(npullers);
+    std::vector<std::thread*> threads;
+    std::latch done(npullers);
+    Executor* pExecutor(nullptr);
+
+    if (msgSize < 2*sizeof(uint64_t)) {
+        msgSize = 2*sizeof(uint64_t);        // Room for the timestamp.
+    }
+
+    checkstat(
+        nng_push0_open(&s),
+        "Unable to create push socket."
+    );
+    checkstat(
+        perfListen(s, uri.c_str(), nullptr, 0),
+        "Unable to start pusher listening."
+    );
+
+    if (coro) {
+        pExecutor = new Executor(nexec);
+    }
+    for (int i = 0; i < npullers; i++) {
+        nng_socket ps = openPuller(uri);
+        pullSockets.push_back(ps);
+        if (coro) {
+            coPuller(*pExecutor, ps, &latencies[i], &done);
+        } else {
+            threads.push_back(new std::thread(threadPuller, ps, &latencies[i]));
+        }
+    }
+    sleep(1 + npullers/1000);              // Let the connections settle.
+    int nthreads = threadCount();
+
+    auto start = std::chrono::high_resolution_clock::now();
+    pusher(s, nmsg, msgSize);
+    while (received < nmsg) {
+        usleep(100);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    // Shut the pullers down.
+
+    if (coro) {
+        for (auto ps : pullSockets) {
+            nng_close(ps);
+        }
+        done.wait();
+        delete pExecutor;
+    } else {
+        finished = true;
+        for (auto p : threads) {
+            p->join();
+            delete p;
+        }
+        for (auto ps : pullSockets) {
+            nng_close(ps);
+        }
+    }
+    nng_close(s);
+
+    std::vector<uint64_t> all;
+    all.reserve(nmsg);
+    for (auto& l : latencies) {
+        all.insert(all.end(), l.begin(), l.end());
+    }
+    std::sort(all.begin(), all.end());
+
+    auto duration  = end - start;
+    double timing = (double)std::chrono::duration_cast<std::chrono::milliseconds>(duration).count()/1000.0;
+
+    std::cout << (coro ? "Coroutine pullers: " : "Thread pullers: ") << npullers << std::endl;
+    std::cout << "Time:       " << timing << std::endl;
+    std::cout << "msgs/sec:   " << (double)nmsg/timing << std::endl;
+    std::cout << "KB/sec:     " << (double)(nmsg * msgSize)/timing/1024.0 << std::endl;
+    std::cout << "Latency (us) p50:   " << percentile(all, 50.0) << std::endl;
+    std::cout << "Latency (us) p99:   " << percentile(all, 99.0) << std::endl;
+    std::cout << "Latency (us) max:   " << (all.empty() ? 0.0 : all.back()/1000.0) << std::endl;
+    std::cout << "Threads:            " << nthreads << std::endl;
+    std::cout << "Peak RSS (KB):      " << peakRssKB() << std::endl;
+
+    return EXIT_SUCCESS;
+}
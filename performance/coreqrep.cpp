@@ -0,0 +1,308 @@
+/**
+ * This program compares thread per socket REQ/REP with coroutines (coro.h)
+ * when there are many clients.
+ *
+ * Usage:
+ *     coreqrep uri nclients nreq msgsize mode [thinkms [nexec]]
+ *
+ * Where uri      - is the URI on which the replier listens.
+ *       nclients - is the number of REQ sockets (hundreds is the point).
+ *       nreq     - is the number of requests each client makes.
+ *       msgsize  - is the size of each request; the replier echoes it.
+ *       mode     - threads - each client is a thread doing blocking
+ *                            send/receive as in reqrep, and the replier has
+ *                            a thread per context.
+ *                  coro    - clients and replier contexts are coroutines
+ *                            on an Executor.
+ *       thinkms  - milliseconds each client waits between requests
+ *                  (default 0).  Mostly idle clients are where a thread
+ *                  each is most wasteful.
+ *       nexec    - number of executor threads in coro mode (default 2).
+ *
+ * The replier is one REP socket with a context for each client so no
+ * request queues behind another.
+ *
+ * Output is requests/sec over all clients, request latency percentiles,
+ * the number of threads in the process while the clients run and the
+ * peak RSS.
+ */
+#include <thread>
+#include <nng/nng.h>
+#include <nng/protocol/reqrep0/req.h>
+#include <nng/protocol/reqrep0/rep.h>
+
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <latch>
+#include <algorithm>
+#include <string>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <vector>
+
+#include "recvmode.h"
+#include "netns.h"
+#include "coro.h"
+#include "perfutil.h"
+
+
+/**
+ * openClient
+ *    Make a REQ socket dialed to the replier.
+ */
+static nng_socket
+openClient(const std::string& uri) {
+    nng_socket s;
+    checkstat(
+        nng_req0_open(&s),
+        "Could not make requester socket"
+    );
+    checkstat(
+        nng_dial(s, uri.c_str(), nullptr, 0),
+        "Could not dial the replier."
+    );
+    return s;
+}
+
+/**
+ * threadReplier
+ *    Echo requests on one context of the REP socket until it's closed.
+ *
+ * @param s - the listening REP socket.
+ */
+static void
+threadReplier(nng_socket s) {
+    nng_ctx  ctx;
+    nng_aio* pAio;
+    checkstat(nng_ctx_open(&ctx, s), "Unable to open a reply context");
+    checkstat(nng_aio_alloc(&pAio, nullptr, nullptr), "Unable to allocate an aio");
+
+    while (true) {
+        nng_ctx_recv(ctx, pAio);
+        nng_aio_wait(pAio);
+        int status = nng_aio_result(pAio);
+        if (status == NNG_ECLOSED) break;
+        checkstat(status, "Could not receive a request");
+
+        nng_aio_set_msg(pAio, nng_aio_get_msg(pAio));     // Echo it.
+        nng_ctx_send(ctx, pAio);
+        nng_aio_wait(pAio);
+        status = nng_aio_result(pAio);
+        if (status) {
+            nng_msg_free(nng_aio_get_msg(pAio));
+            if (status == NNG_ECLOSED) break;
+            checkstat(status, "Could not send a reply.");
+        }
+    }
+    nng_aio_free(pAio);
+}
+
+/**
+ * coReplier
+ *    The coroutine version of threadReplier.
+ *
+ * @param executor - where we are resumed.
+ * @param s        - the listening REP socket.
+ * @param pDone    - counted down when the socket is closed.
+ */
+static Task
+coReplier(Executor& executor, nng_socket s, std::latch* pDone) {
+    nng_ctx ctx;
+    checkstat(nng_ctx_open(&ctx, s), "Unable to open a reply context");
+    {
+        CoSocket cs(executor, ctx);
+        while (true) {
+            nng_msg* pMsg;
+            int status = co_await cs.recv(&pMsg);
+            if (status == NNG_ECLOSED) break;
+            checkstat(status, "Could not receive a request");
+
+            status = co_await cs.send(pMsg);            // Echo it.
+            if (status) {
+                nng_msg_free(pMsg);
+                if (status == NNG_ECLOSED) break;
+                checkstat(status, "Could not send a reply.");
+            }
+        }
+    }
+    pDone->count_down();
+}
+
+/**
+ * threadClient
+ *    nreq requests of msgSize bytes, timing each.
+ *
+ * @param s        - dialed REQ socket.
+ * @param nreq     - number of requests.
+ * @param msgSize  - request size.
+ * @param thinkms  - wait between requests.
+ * @param pLatencies[out] - latencies in ns.
+ */
+static void
+threadClient(nng_socket s, size_t nreq, size_t msgSize, int thinkms, std::vector<uint64_t>* pLatencies) {
+    uint8_t* request = new uint8_t[msgSize];
+    memset(request, 0, msgSize);
+    perfReceiverSetup();
+
+    for (int i = 0; i < nreq; i++) {
+        void*  reply;
+        size_t repsize;
+        uint64_t start = now();
+        checkstat(
+            tracedSend(s, request, msgSize, 0),
+            "Unable to make request"
+        );
+        checkstat(
+            perfRecv(s, &reply, &repsize),
+            "Unable to receive a reply to our request"
+        );
+        nng_free(reply, repsize);
+        pLatencies->push_back(now() - start);
+        if (thinkms) {
+            usleep(thinkms * 1000);
+        }
+    }
+    delete []request;
+}
+
+/**
+ * coClient
+ *    The coroutine version of threadClient.
+ *
+ * @param executor - where we are resumed.
+ * @param pDone    - counted down when we're done.
+ */
+static Task
+coClient(
+    Executor& executor, nng_socket s, size_t nreq, size_t msgSize, int thinkms,
+    std::vector<uint64_t>* pLatencies, std::latch* pDone
+) {
+    {
+        CoSocket cs(executor, s);
+        for (int i = 0; i < nreq; i++) {
+            nng_msg* pMsg;
+            checkstat(nng_msg_alloc(&pMsg, msgSize), "Unable to allocate a request");
+            memset(nng_msg_body(pMsg), 0, msgSize);
+
+            uint64_t start = now();
+            int status = co_await cs.send(pMsg);
+            if (status) {
+                nng_msg_free(pMsg);
+                checkstat(status, "Unable to make request");
+            }
+            checkstat(
+                co_await cs.recv(&pMsg),
+                "Unable to receive a reply to our request"
+            );
+            nng_msg_free(pMsg);
+            pLatencies->push_back(now() - start);
+            if (thinkms) {
+                co_await cs.sleep(thinkms);
+            }
+        }
+    }
+    pDone->count_down();
+}
+
+/**
+ *  Entry point
+ * @note - this is not production code so missing command line
+ * parameters most likely result in a segfault.
+ */
+int main(int argc, char** argv) {
+    std::string uri(argv[1]);
+    size_t nclients = atol(argv[2]);
+    size_t nreq     = atol(argv[3]);
+    size_t msgSize  = atol(argv[4]);
+    bool   coro     = std::string(argv[5]) == "coro";
+    int    thinkms  = (argc > 6) ? atoi(argv[6]) : 0;
+    size_t nexec    = (argc > 7) ? atol(argv[7]) : 2;
+    nng_socket s;
+    std::vector<nng_socket> clientSockets;
+    std::vector<std::vector<uint64_t>> latencies(nclients);
+    std::vector<std::thread*> replierThreads;
+    std::vector<std::thread*> clientThreads;
+    std::latch repliersDone(nclients);
+    std::latch clientsDone(nclients);
+    Executor* pExecutor(nullptr);
+
+    checkstat(
+        nng_rep0_open(&s),
+        "Unable to open reply socket."
+    );
+    checkstat(
+        perfListen(s, uri.c_str(), nullptr, 0),
+        "Replier unable to start listening."
+    );
+    if (coro) {
+        pExecutor = new Executor(nexec);
+    }
+    for (int i = 0; i < nclients; i++) {
+        if (coro) {
+            coReplier(*pExecutor, s, &repliersDone);
+        } else {
+            replierThreads.push_back(new std::thread(threadReplier, s));
+        }
+        clientSockets.push_back(openClient(uri));
+        latencies[i].reserve(nreq);
+    }
+    sleep(1 + nclients/1000);             // Let the connections settle.
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < nclients; i++) {
+        if (coro) {
+            coClient(*pExecutor, clientSockets[i], nreq, msgSize, thinkms, &latencies[i], &clientsDone);
+        } else {
+            clientThreads.push_back(new std::thread(
+                threadClient, clientSockets[i], nreq, msgSize, thinkms, &latencies[i]
+            ));
+        }
+    }
+    int nthreads = threadCount();
+    if (coro) {
+        clientsDone.wait();
+    } else {
+        for (auto p : clientThreads) {
+            p->join();
+            delete p;
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    // Shutdown - closing the REP socket ends the repliers.
+
+    for (auto cs : clientSockets) {
+        nng_close(cs);
+    }
+    nng_close(s);
+    if (coro) {
+        repliersDone.wait();
+        delete pExecutor;
+    } else {
+        for (auto p : replierThreads) {
+            p->join();
+            delete p;
+        }
+    }
+
+    std::vector<uint64_t> all;
+    for (auto& l : latencies) {
+        all.insert(all.end(), l.begin(), l.end());
+    }
+    std::sort(all.begin(), all.end());
+    double secs = (double)std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count()/1000.0;
+
+    std::cout << (coro ? "Coroutine clients: " : "Thread clients: ") << nclients << std::endl;
+    std::cout << "Elapsed sec:        " << secs << std::endl;
+    std::cout << "req/sec    :        " << (double)(nclients * nreq)/secs << std::endl;
+    std::cout << "Latency (us) p50:   " << percentile(all, 50.0) << std::endl;
+    std::cout << "Latency (us) p99:   " << percentile(all, 99.0) << std::endl;
+    std::cout << "Latency (us) max:   " << (all.empty() ? 0.0 : all.back()/1000.0) << std::endl;
+    std::cout << "Threads:            " << nthreads << std::endl;
+    std::cout << "Peak RSS (KB):      " << peakRssKB() << std::endl;
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,250 @@
+/**
+ * C++20 coroutines over nng_aio.
+ *
+ * The performance programs use a blocking thread per socket.  That's
+ * simple but hundreds of endpoints means hundreds of threads and their
+ * stacks.  This header lets one coroutine per endpoint do the same
+ * blocking style work on a small pool of threads:
+ *
+ *   Executor   - nthreads threads resuming coroutines from a queue.
+ *   Task       - return type of a coroutine; it starts running at once
+ *                and destroys itself when it finishes.
+ *   CoSocket   - one nng_aio bound to a socket or context:
+ *                   int status = co_await cs.send(pMsg);
+ *                   int status = co_await cs.recv(&pMsg);
+ *                   int status = co_await cs.sleep(ms);
+ *
+ * The aio callback only posts the suspended coroutine to the executor, so
+ * nng's threads never run user code and everything after a co_await runs
+ * on an executor thread.  Message ownership is as for nng_sendmsg and
+ * nng_recvmsg: a successful send takes the message, a failed one leaves
+ * it with the caller.  A CoSocket does one operation at a time; use a
+ * context (nng_ctx) per coroutine to share a socket.  Closing the socket
+ * completes a pending operation with NNG_ECLOSED.  Sends and receives
+ * are traced (trace.h) from the start of the operation to the
+ * coroutine's resumption.
+ */
+#ifndef CORO_H
+#define CORO_H
+
+#include <nng/nng.h>
+
+#include <coroutine>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdlib.h>
+
+#include "trace.h"
+
+/**
+ * Executor
+ *    A fixed pool of threads that resume posted coroutines.
+ */
+class Executor {
+public:
+    explicit Executor(size_t nthreads = 1) :
+        m_stopping(false) {
+        for (int i = 0; i < nthreads; i++) {
+            m_threads.emplace_back(&Executor::run, this);
+        }
+    }
+    ~Executor() {
+        {
+            std::lock_guard<std::mutex> l(m_lock);
+            m_stopping = true;
+        }
+        m_ready.notify_all();
+        for (auto& t : m_threads) {
+            t.join();
+        }
+    }
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+    /**
+     * post
+     *    Queue a coroutine to be resumed by one of our threads.
+     */
+    void post(std::coroutine_handle<> h) {
+        std::lock_guard<std::mutex> l(m_lock);   // Notify under the lock: the
+        m_queue.push_back(h);                    // coroutine we wake may
+        m_ready.notify_one();                    // delete us.
+    }
+    size_t threads() const { return m_threads.size(); }
+
+private:
+    void run() {
+        while (true) {
+            std::coroutine_handle<> h;
+            {
+                std::unique_lock<std::mutex> l(m_lock);
+                m_ready.wait(l, [this] { return m_stopping || !m_queue.empty(); });
+                if (m_queue.empty()) return;           // Stopping and drained.
+                h = m_queue.front();
+                m_queue.pop_front();
+            }
+            h.resume();
+        }
+    }
+
+    std::mutex                          m_lock;
+    std::condition_variable             m_ready;
+    std::deque<std::coroutine_handle<>> m_queue;
+    std::vector<std::thread>            m_threads;
+    bool                                m_stopping;
+};
+
+/**
+ * Task
+ *    Fire and forget coroutine.  Completion is the coroutine's business
+ *  (e.g. count down a std::latch as its last act).
+ */
+struct Task {
+    struct promise_type {
+        Task get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+/**
+ * CoSocket
+ *    Awaitable send/recv/sleep on a socket or context.
+ */
+class CoSocket {
+public:
+    CoSocket(Executor& executor, nng_socket s) :
+        m_executor(executor), m_socket(s), m_useCtx(false),
+        m_timeout(NNG_DURATION_DEFAULT) {
+        allocate();
+    }
+    CoSocket(Executor& executor, nng_ctx c) :
+        m_executor(executor), m_ctx(c), m_useCtx(true),
+        m_timeout(NNG_DURATION_DEFAULT) {
+        allocate();
+    }
+    ~CoSocket() {
+        nng_aio_free(m_pAio);
+    }
+    CoSocket(const CoSocket&) = delete;
+    CoSocket& operator=(const CoSocket&) = delete;
+
+    /**
+     * Operation
+     *    The awaitable returned by send, recv and sleep.  co_await yields
+     *  the nng status of the operation.
+     */
+    class Operation {
+    public:
+        enum Kind {SEND, RECV, SLEEP};
+        Operation(CoSocket& cs, Kind kind, nng_msg* pMsg, nng_msg** ppMsg, nng_duration ms) :
+            m_cs(cs), m_kind(kind), m_pMsg(pMsg), m_ppMsg(ppMsg), m_ms(ms) {}
+
+        bool await_ready() const noexcept { return false; }
+
+        // Nothing may touch *this once the operation is started - the
+        // callback can resume the coroutine on another thread before we
+        // return.
+
+        void await_suspend(std::coroutine_handle<> h) {
+            m_cs.m_waiter = h;
+            m_cs.m_traceStart = traceEnabled() ? traceNow() : 0;
+            nng_aio* pAio = m_cs.m_pAio;
+            if (m_kind != SLEEP) {
+                nng_aio_set_timeout(pAio, m_cs.m_timeout);   // A sleep may have changed it.
+            }
+            switch (m_kind) {
+            case SEND:
+                nng_aio_set_msg(pAio, m_pMsg);
+                if (m_cs.m_useCtx) {
+                    nng_ctx_send(m_cs.m_ctx, pAio);
+                } else {
+                    nng_send_aio(m_cs.m_socket, pAio);
+                }
+                break;
+            case RECV:
+                if (m_cs.m_useCtx) {
+                    nng_ctx_recv(m_cs.m_ctx, pAio);
+                } else {
+                    nng_recv_aio(m_cs.m_socket, pAio);
+                }
+                break;
+            case SLEEP:
+                nng_sleep_aio(m_ms, pAio);
+                break;
+            }
+        }
+        int await_resume() {
+            int status = nng_aio_result(m_cs.m_pAio);
+            if (m_kind == RECV && status == 0) {
+                *m_ppMsg = nng_aio_get_msg(m_cs.m_pAio);
+            }
+            if (m_cs.m_traceStart && m_kind != SLEEP) {    // Start to resumption.
+                bool send = m_kind == SEND;
+                traceRecord(
+                    send ? "send" : "recv", m_cs.m_traceStart, traceNow() - m_cs.m_traceStart,
+                    send ? traceNextSend() : traceNextRecv()
+                );
+            }
+            return status;
+        }
+
+    private:
+        CoSocket&    m_cs;
+        Kind         m_kind;
+        nng_msg*     m_pMsg;
+        nng_msg**    m_ppMsg;
+        nng_duration m_ms;
+    };
+
+    Operation send(nng_msg* pMsg) {
+        return Operation(*this, Operation::SEND, pMsg, nullptr, 0);
+    }
+    Operation recv(nng_msg** ppMsg) {
+        return Operation(*this, Operation::RECV, nullptr, ppMsg, 0);
+    }
+    Operation sleep(nng_duration ms) {
+        return Operation(*this, Operation::SLEEP, nullptr, nullptr, ms);
+    }
+
+    /**
+     * setTimeout
+     *    By default send/recv on a socket time out after its
+     *  SENDTIMEO/RECVTIMEO; this overrides that (NNG_DURATION_INFINITE
+     *  to never time out).
+     */
+    void setTimeout(nng_duration ms) {
+        m_timeout = ms;
+    }
+
+private:
+    void allocate() {
+        int status = nng_aio_alloc(&m_pAio, callback, this);
+        if (status) {
+            std::cerr << "Unable to allocate an aio: " << nng_strerror(status) << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    static void callback(void* arg) {
+        CoSocket* pSelf = reinterpret_cast<CoSocket*>(arg);
+        pSelf->m_executor.post(pSelf->m_waiter);
+    }
+
+    Executor&               m_executor;
+    nng_socket              m_socket;
+    nng_ctx                 m_ctx;
+    bool                    m_useCtx;
+    nng_duration            m_timeout;
+    nng_aio*                m_pAio;
+    uint64_t                m_traceStart;      // 0 if not tracing.
+    std::coroutine_handle<> m_waiter;
+};
+
+#endif
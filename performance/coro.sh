@@ -0,0 +1,22 @@
+#!/bin/bash
+
+# Thread per socket vs. coroutines (coro.h) as the number of endpoints
+# grows.  Look at msgs|req/sec, the latency percentiles, Threads and
+# Peak RSS.
+
+echo Coroutine log > coro.log
+
+for n in 10 100 500 1000
+do
+    for mode in threads coro
+    do
+	echo ---- push/pull $n pullers $mode -------- >> coro.log
+	./copushpull tcp://localhost:3000 1000000 100 $n $mode >> coro.log
+
+	echo ---- req/rep $n clients $mode -------- >> coro.log
+	./coreqrep tcp://localhost:3001 $n 1000 100 $mode >> coro.log
+
+	echo ---- req/rep $n clients $mode 10ms think -------- >> coro.log
+	./coreqrep tcp://localhost:3002 $n 100 100 $mode 10 >> coro.log
+    done
+done
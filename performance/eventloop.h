@@ -0,0 +1,168 @@
+/**
+ * An event loop for receiving on many sockets with a few threads.
+ *
+ * Each socket added with addReceiver has an nng_aio receive outstanding.
+ * The aio callback only queues the socket as ready; one or more dispatch
+ * threads take ready sockets off the queue, hand the message to the
+ * socket's handler and start the next receive.  A socket is on the queue
+ * at most once so its handler is never run concurrently with itself,
+ * even with several dispatch threads.
+ *
+ * A socket stops being received on when its handler returns false or the
+ * socket is closed (NNG_ECLOSED).  Receive timeouts (the socket's
+ * RECVTIMEO) just restart the receive.  wait() returns once every
+ * socket has stopped.
+ *
+ * Unlike coro.h there's no per endpoint state other than what the
+ * handler's argument points to - this is the shape of a server that
+ * fans in from thousands of publishers or pushers.
+ *
+ * Each handler call is traced (trace.h) as "process".
+ */
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+
+#include <nng/nng.h>
+
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "trace.h"
+#include <stdlib.h>
+
+class EventLoop {
+public:
+    // Called with each message (which the handler now owns).  Return
+    // false to stop receiving on the socket.
+
+    typedef bool (*Handler)(nng_msg* pMsg, void* pArg);
+
+    explicit EventLoop(size_t nthreads = 1) :
+        m_active(0), m_stopping(false) {
+        for (int i = 0; i < nthreads; i++) {
+            m_threads.emplace_back(&EventLoop::dispatch, this);
+        }
+    }
+    ~EventLoop() {
+        {
+            std::lock_guard<std::mutex> l(m_lock);
+            m_stopping = true;
+            m_ready.notify_all();
+        }
+        for (auto& t : m_threads) {
+            t.join();
+        }
+    }
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    /**
+     * addReceiver
+     *    Start receiving on a socket.
+     *
+     * @param s       - socket (dialed/listening and subscribed as needed).
+     * @param handler - called on a dispatch thread for each message.
+     * @param pArg    - passed to the handler.
+     */
+    void addReceiver(nng_socket s, Handler handler, void* pArg) {
+        Receiver* pReceiver = new Receiver;
+        pReceiver->pLoop   = this;
+        pReceiver->socket  = s;
+        pReceiver->handler = handler;
+        pReceiver->pArg    = pArg;
+        int status = nng_aio_alloc(&pReceiver->pAio, callback, pReceiver);
+        if (status) {
+            std::cerr << "Unable to allocate an aio: " << nng_strerror(status) << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        {
+            std::lock_guard<std::mutex> l(m_lock);
+            m_active++;
+        }
+        nng_recv_aio(s, pReceiver->pAio);
+    }
+
+    /**
+     * wait
+     *    Block until every receiver has stopped.
+     */
+    void wait() {
+        std::unique_lock<std::mutex> l(m_lock);
+        m_idle.wait(l, [this] { return m_active == 0; });
+    }
+
+private:
+    struct Receiver {
+        EventLoop* pLoop;
+        nng_socket socket;
+        nng_aio*   pAio;
+        Handler    handler;
+        void*      pArg;
+    };
+
+    static void callback(void* arg) {
+        Receiver* pReceiver = reinterpret_cast<Receiver*>(arg);
+        EventLoop* pLoop = pReceiver->pLoop;
+        std::lock_guard<std::mutex> l(pLoop->m_lock);
+        pLoop->m_queue.push_back(pReceiver);
+        pLoop->m_ready.notify_one();
+    }
+
+    // Take everything that's ready in one go so a busy loop takes the
+    // lock once per batch rather than once per message.
+
+    void dispatch() {
+        std::deque<Receiver*> ready;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> l(m_lock);
+                m_ready.wait(l, [this] { return m_stopping || !m_queue.empty(); });
+                if (m_queue.empty()) return;            // Stopping and drained.
+                ready.swap(m_queue);
+            }
+            for (auto pReceiver : ready) {
+                handle(pReceiver);
+            }
+            ready.clear();
+        }
+    }
+
+    void handle(Receiver* pReceiver) {
+        int status = nng_aio_result(pReceiver->pAio);
+        bool more;
+        if (status == 0) {
+            TraceScope trace("process", traceNextRecv());
+            more = pReceiver->handler(nng_aio_get_msg(pReceiver->pAio), pReceiver->pArg);
+        } else {
+            if (status != NNG_ECLOSED && status != NNG_ETIMEDOUT) {
+                std::cerr << "Event loop receive failed: " << nng_strerror(status) << std::endl;
+            }
+            more = status == NNG_ETIMEDOUT;
+        }
+        if (more) {
+            nng_recv_aio(pReceiver->socket, pReceiver->pAio);
+            return;
+        }
+        nng_aio_free(pReceiver->pAio);
+        delete pReceiver;
+
+        std::lock_guard<std::mutex> l(m_lock);
+        if (--m_active == 0) {
+            m_idle.notify_all();
+        }
+    }
+
+    std::mutex               m_lock;
+    std::condition_variable  m_ready;
+    std::condition_variable  m_idle;
+    std::deque<Receiver*>    m_queue;
+    std::vector<std::thread> m_threads;
+    size_t                   m_active;
+    bool                     m_stopping;
+};
+
+#endif
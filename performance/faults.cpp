@@ -0,0 +1,306 @@
+/**
+ *  This program injects a consumer fault into a push/pull or pub/sub
+ * stream and records the effect over time.  The Readme says a crashed
+ * consumer will bring things to a halt - this measures how much.
+ *
+ *   Usage:
+ *      faults URI pattern nconsumers size runms faultms fault [resumems]
+ *
+ *   Where:
+ *     URI        - is the URI the sender listens on.
+ *     pattern    - push - the consumers are pullers.
+ *                  pub  - the consumers are subscribers.
+ *     nconsumers - number of consumer processes.
+ *     size       - message size in bytes.
+ *     runms      - how long the sender sends (as fast as it can).
+ *     faultms    - when consumer 0 (the victim) is hit.
+ *     fault      - stop - SIGSTOP the victim (a hung worker).
+ *                  kill - SIGKILL the victim (a crashed worker).
+ *     resumems   - for stop, when to SIGCONT the victim (default never).
+ *
+ *   The consumers are processes (a thread can't be stopped by itself)
+ *   forked before this process touches nng.  Each counts what it
+ *   receives into a counter in shared memory so there's no reporting
+ *   traffic to disturb the measurement.
+ *
+ *   Every 100ms the main thread samples the counters and the sender's
+ *   time spent inside nng_send.  At the end it prints one line per
+ *   sample:
+ *     t(ms)      - time since the start.
+ *     sent/s     - sender's rate over the interval.
+ *     blocked%   - share of the interval the sender spent in nng_send,
+ *                  including the part so far of a send still pending.
+ *     maxsend(ms) - the longest single nng_send in the interval (or the
+ *                  pending one, so far, if longer).
+ *     victim/s   - the victim's receive rate.
+ *     others/s   - the other consumers' total receive rate.
+ *     minother/s - the slowest other consumer's rate.
+ *   followed by the sender's rate before and after the fault.
+ */
+#include <thread>
+#include <nng/nng.h>
+#include <nng/protocol/pipeline0/push.h>
+#include <nng/protocol/pipeline0/pull.h>
+#include <nng/protocol/pubsub0/pub.h>
+#include <nng/protocol/pubsub0/sub.h>
+
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "trace.h"
+#include "netns.h"
+#include "perfutil.h"
+#include "backpressure.h"
+
+
+static const uint64_t INTERVAL_NS(100*1000*1000);      // Sampling interval.
+
+/**
+ * consumer
+ *    A consumer process: wait for the go, dial and count until killed.
+ *
+ * @param uri      - sender's URI.
+ * @param sub      - true for a subscriber, false for a puller.
+ * @param startFd  - read end of the start pipe (EOF means go).
+ * @param pCount   - our counter in shared memory.
+ */
+static void
+consumer(const std::string& uri, bool sub, int startFd, std::atomic<uint64_t>* pCount) {
+    char c;
+    nng_socket s;
+    read(startFd, &c, 1);
+
+    if (sub) {
+        checkstat(nng_sub0_open(&s), "Unable to open a sub socket.");
+        checkstat(
+            nng_setopt(s, NNG_OPT_SUB_SUBSCRIBE, "", 0),
+            "Could not set subscription"
+        );
+    } else {
+        checkstat(nng_pull0_open(&s), "Unable to open a pull socket.");
+    }
+    checkstat(
+        nng_dial(s, uri.c_str(), nullptr, 0),
+        "Consumer could not dial the sender"
+    );
+    while (true) {
+        void*  pMsg;
+        size_t size;
+        checkstat(
+            tracedRecv(s, &pMsg, &size, NNG_FLAG_ALLOC),
+            "Consumer failed to receive"
+        );
+        nng_free(pMsg, size);
+        pCount->fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+static std::atomic<bool>     sending(true);   // Sender runs while true.
+static std::atomic<uint64_t> sent(0);         // Messages sent.
+static SendTimer             sendTimer;      // Time inside nng_send (backpressure.h).
+
+/**
+ * sender
+ *    Send as fast as we can, accounting the time in nng_send.
+ */
+static void
+sender(nng_socket s, size_t msgSize) {
+    uint8_t* pMessage = new uint8_t[msgSize];
+    memset(pMessage, 0, msgSize);
+    while (sending) {
+        uint64_t before = sendTimer.begin();
+        int status = tracedSend(s, pMessage, msgSize, 0);
+        sendTimer.end(before);
+        if (status == NNG_ECLOSED) break;      // main closed us to stop.
+        checkstat(status, "Failed to send");
+        sent++;
+    }
+    delete []pMessage;
+}
+
+/**
+ *  One line of the timeline.
+ */
+struct Sample {
+    uint64_t t;
+    double   sentRate;
+    double   blocked;
+    double   maxSend;
+    double   victimRate;
+    double   othersRate;
+    double   minOtherRate;
+};
+
+/**
+ *  Entry point
+ * @note - this is not production code so missing command line
+ * parameters most likely result in a segfault.
+ */
+int main(int argc, char** argv) {
+    std::string uri(argv[1]);
+    bool        sub        = std::string(argv[2]) == "pub";
+    size_t      nconsumers = atol(argv[3]);
+    size_t      msgSize    = atol(argv[4]);
+    uint64_t    runms      = atol(argv[5]);
+    uint64_t    faultms    = atol(argv[6]);
+    bool        stop       = std::string(argv[7]) == "stop";
+    uint64_t    resumems   = (argc > 8) ? atol(argv[8]) : 0;
+
+    // Counters shared with the consumers:
+
+    void* pShared = mmap(
+        nullptr, nconsumers * sizeof(std::atomic<uint64_t>),
+        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0
+    );
+    if (pShared == MAP_FAILED) {
+        perror("Unable to map the counters");
+        exit(EXIT_FAILURE);
+    }
+    std::atomic<uint64_t>* counts = reinterpret_cast<std::atomic<uint64_t>*>(pShared);
+    for (int i = 0; i < nconsumers; i++) {
+        new (&counts[i]) std::atomic<uint64_t>(0);
+    }
+
+    // Fork the consumers before nng is used in this process.
+
+    int startPipe[2];
+    if (pipe(startPipe)) {
+        perror("Unable to make the start pipe");
+        exit(EXIT_FAILURE);
+    }
+    std::vector<pid_t> consumers;
+    for (int i = 0; i < nconsumers; i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(startPipe[1]);
+            consumer(uri, sub, startPipe[0], &counts[i]);
+            _exit(EXIT_SUCCESS);
+        }
+        if (pid < 0) {
+            perror("fork failed");
+            exit(EXIT_FAILURE);
+        }
+        consumers.push_back(pid);
+    }
+
+    nng_socket s;
+    if (sub) {
+        checkstat(nng_pub0_open(&s), "Publisher could not open socket");
+    } else {
+        checkstat(nng_push0_open(&s), "Unable to create push socket.");
+    }
+    checkstat(
+        perfListen(s, uri.c_str(), nullptr, 0),
+        "Sender could not start listening"
+    );
+    close(startPipe[1]);                    // Go.
+    sleep(1 + nconsumers/1000);             // Let them all connect.
+
+    // Run, sampling each interval and hitting the victim on time:
+
+    std::vector<Sample>   samples;
+    std::vector<uint64_t> last(nconsumers, 0);
+    uint64_t lastSent = 0, lastSendNs = 0;
+    bool faulted = false, resumed = false;
+
+    uint64_t start = now();
+    std::thread sendThread(sender, s, msgSize);
+    for (uint64_t t = start + INTERVAL_NS; t <= start + runms*1000*1000; t += INTERVAL_NS) {
+        struct timespec ts;
+        ts.tv_sec  = t / 1000000000;
+        ts.tv_nsec = t % 1000000000;
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr);
+
+        uint64_t elapsedMs = (t - start)/1000000;
+        if (!faulted && elapsedMs >= faultms) {
+            kill(consumers[0], stop ? SIGSTOP : SIGKILL);
+            faulted = true;
+        }
+        if (stop && resumems && !resumed && elapsedMs >= resumems) {
+            kill(consumers[0], SIGCONT);
+            resumed = true;
+        }
+
+        Sample sample;
+        double secs = INTERVAL_NS/1.0e9;
+        uint64_t nowSendNs, maxSendNs;
+        sendTimer.sample(now(), nowSendNs, maxSendNs);
+        uint64_t nowSent = sent;
+        sample.t        = elapsedMs;
+        sample.sentRate = (nowSent - lastSent)/secs;
+        sample.blocked  = 100.0*(nowSendNs - lastSendNs)/INTERVAL_NS;
+        sample.maxSend  = maxSendNs/1.0e6;
+        lastSent   = nowSent;
+        lastSendNs = nowSendNs;
+
+        sample.othersRate = 0;
+        sample.minOtherRate = 0;
+        for (int i = 0; i < nconsumers; i++) {
+            uint64_t c = counts[i];
+            double rate = (c - last[i])/secs;
+            last[i] = c;
+            if (i == 0) {
+                sample.victimRate = rate;
+            } else {
+                sample.othersRate += rate;
+                if (i == 1 || rate < sample.minOtherRate) sample.minOtherRate = rate;
+            }
+        }
+        samples.push_back(sample);
+    }
+
+    // Stop the sender.  If it's stuck sending to the victim, closing
+    // the socket gets it out.
+
+    sending = false;
+    if (stop && !resumed) kill(consumers[0], SIGCONT);
+    for (auto pid : consumers) {
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+    }
+    nng_close(s);
+    sendThread.join();
+
+    std::cout << (sub ? "pub/sub " : "push/pull ") << nconsumers << " consumers, victim "
+              << (stop ? "stopped" : "killed") << " at " << faultms << "ms";
+    if (resumed) std::cout << " continued at " << resumems << "ms";
+    std::cout << std::endl;
+    std::cout << "t(ms)      sent/s  blocked%  maxsend(ms)    victim/s    others/s  minother/s\n";
+    double before = 0, after = 0;
+    size_t nbefore = 0, nafter = 0;
+    for (auto& sample : samples) {
+        std::cout << std::setw(5) << sample.t << " "
+                  << std::fixed << std::setprecision(0)
+                  << std::setw(11) << sample.sentRate << " "
+                  << std::setprecision(1) << std::setw(9) << sample.blocked << " "
+                  << std::setprecision(3) << std::setw(12) << sample.maxSend << " "
+                  << std::setprecision(0)
+                  << std::setw(11) << sample.victimRate << " "
+                  << std::setw(11) << sample.othersRate << " "
+                  << std::setw(11) << sample.minOtherRate << std::endl;
+        if (sample.t <= faultms) {
+            before += sample.sentRate;
+            nbefore++;
+        } else if (!resumed || sample.t <= resumems) {
+            after += sample.sentRate;
+            nafter++;
+        }
+    }
+    std::cout << "Sender msgs/sec before fault: " << (nbefore ? before/nbefore : 0.0) << std::endl;
+    std::cout << "Sender msgs/sec after fault:  " << (nafter ? after/nafter : 0.0) << std::endl;
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,18 @@
+#!/bin/bash
+
+# Blast radius of one hung or crashed consumer.  10 second runs with the
+# victim hit at 3 seconds; the stopped victim is continued at 7 seconds.
+
+echo Fault injection log > faults.log
+
+for pattern in push pub
+do
+    for consumers in 2 4 16
+    do
+	echo ---- $pattern $consumers consumers stop -------- >> faults.log
+	./faults tcp://localhost:3000 $pattern $consumers 100 10000 3000 stop 7000 >> faults.log
+
+	echo ---- $pattern $consumers consumers kill -------- >> faults.log
+	./faults tcp://localhost:3000 $pattern $consumers 100 10000 3000 kill >> faults.log
+    done
+done
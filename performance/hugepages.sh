@@ -0,0 +1,38 @@
+#!/bin/bash
+
+# Sender buffers in normal pages, transparent huge pages and hugetlb
+# pages (see sendbuffer.h) at the large message sizes, with the sender's
+# dTLB misses.  hugetlb needs pages reserved first, e.g. as root:
+#    echo 64 > /proc/sys/vm/nr_hugepages
+# Set PERF_MLOCK=1 as well to also lock the buffers.
+#
+# The malloc-thp and malloc-hugetlb runs also put nng's own allocations
+# (message bodies, pooled and received messages) in huge pages with
+# glibc's malloc tunable (glibc 2.35 or later).
+
+echo Huge page log > hugepages.log
+
+export PERF_TLB=1
+
+for size in 262144 524288 1048576
+do
+    for mode in normal thp hugetlb malloc-thp malloc-hugetlb
+    do
+	unset GLIBC_TUNABLES
+	case $mode in
+	    normal)         unset PERF_HUGEPAGES;;
+	    malloc-thp)     export PERF_HUGEPAGES=thp GLIBC_TUNABLES=glibc.malloc.hugetlb=1;;
+	    malloc-hugetlb) export PERF_HUGEPAGES=hugetlb GLIBC_TUNABLES=glibc.malloc.hugetlb=2;;
+	    *)              export PERF_HUGEPAGES=$mode;;
+	esac
+
+	echo ---- pair $size $mode -------- >> hugepages.log
+	echo | ./pair tcp://localhost:3000 10000 $size >> hugepages.log
+	echo ---- pushpull $size $mode -------- >> hugepages.log
+	echo | ./pushpull tcp://localhost:3001 10000 $size 4 >> hugepages.log
+	echo ---- pubsub $size $mode -------- >> hugepages.log
+	echo | ./pubsub tcp://localhost:3002 10000 $size 4 >> hugepages.log
+	echo ---- bus $size $mode -------- >> hugepages.log
+	./bus inproc://bus%d 10000 $size 3 >> hugepages.log
+    done
+done
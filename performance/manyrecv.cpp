@@ -0,0 +1,286 @@
+/**
+ *  This program compares a thread per endpoint with an event loop
+ * (eventloop.h) for a process that receives on many sockets - an
+ * aggregation node with thousands of pullers or subscribers.
+ *
+ *   Usage:
+ *      manyrecv URI pattern nendpoints nmsgs size mode [ndispatch]
+ *
+ *   Where:
+ *     URI        - is the URI the sender listens on.
+ *     pattern    - push - the endpoints are pullers as in pushpull.
+ *                  pub  - the endpoints are subscribers as in pubsub.
+ *     nendpoints - is the number of receiving sockets (10 - 5000 or so).
+ *     nmsgs      - is the number of messages sent.  For pub every
+ *                  subscriber gets (up to) all of them.
+ *     size       - is the size of each message in bytes.
+ *     mode       - threads - a thread per endpoint doing blocking receives
+ *                            like pushpull's puller() and pubsub's
+ *                            subscriber().
+ *                  loop    - all endpoints on an EventLoop.
+ *     ndispatch  - number of event loop dispatch threads (default 1).
+ *
+ *   Completion:
+ *     push - as in pushload, the receivers count messages into a shared
+ *            counter and timing stops when it reaches nmsgs.
+ *     pub  - a publisher may drop messages for a subscriber that's
+ *            behind so we can't count to a total.  After the data the
+ *            publisher sends an end message (first byte nonzero) every
+ *            millisecond until every subscriber has seen one.  The
+ *            fraction of the messages actually delivered is reported.
+ *
+ *   Output:
+ *     - Time, delivered msgs/sec and KB/sec.
+ *     - CPU seconds over the timed part, CPU us per delivered message and
+ *       CPU/wall (cores used).
+ *     - Threads and the growth in resident memory per endpoint from
+ *       setting the endpoints up.
+ */
+#include <thread>
+#include <nng/nng.h>
+#include <nng/protocol/pipeline0/push.h>
+#include <nng/protocol/pipeline0/pull.h>
+#include <nng/protocol/pubsub0/pub.h>
+#include <nng/protocol/pubsub0/sub.h>
+
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <atomic>
+#include <string>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <vector>
+
+#include "recvmode.h"
+#include "netns.h"
+#include "eventloop.h"
+#include "perfutil.h"
+
+
+static std::atomic<size_t> received(0);      // Data messages delivered.
+static std::atomic<size_t> endpointsDone(0); // Subscribers that saw the end.
+static std::atomic<bool>   finished(false);  // Threads can exit.
+
+/**
+ * countMessage
+ *    Account for a received message.
+ * @param pBody - message body.
+ * @return bool - true if it was an end message.
+ */
+static bool
+countMessage(const void* pBody) {
+    if (*reinterpret_cast<const uint8_t*>(pBody)) {
+        endpointsDone++;
+        return true;
+    }
+    received++;
+    return false;
+}
+
+/**
+ * openEndpoint
+ *    Make a receiving socket dialed into the sender.
+ * @param uri - sender's URI.
+ * @param sub - true for a subscriber, false for a puller.
+ */
+static nng_socket
+openEndpoint(const std::string& uri, bool sub) {
+    nng_socket s;
+    if (sub) {
+        checkstat(
+            nng_sub0_open(&s),
+            "Subscriber not able to  open a socket."
+        );
+        checkstat(
+            nng_setopt(s, NNG_OPT_SUB_SUBSCRIBE, "", 0),
+            "Subscsriber could not set subscription"
+        );
+    } else {
+        checkstat(
+            nng_pull0_open(&s),
+            "Unable to open a pull socket."
+        );
+    }
+    checkstat(
+        nng_setopt_ms(s, NNG_OPT_RECVTIMEO, 100),
+        "Unable to set receive timeout"
+    );
+    checkstat(
+        nng_dial(s, uri.c_str(), nullptr, 0),
+        "Endpoint could not dial the sender"
+    );
+    return s;
+}
+
+/**
+ * threadReceiver
+ *    Thread per endpoint: receive until an end message or, for pullers,
+ *  until main says we're finished.
+ *
+ * @param s - the endpoint's socket.
+ */
+static void
+threadReceiver(nng_socket s) {
+    void*  pMsg;
+    size_t rcvSize;
+    bool   done(false);
+    perfReceiverSetup();
+
+    while (!done) {
+        int status = perfRecv(s, &pMsg, &rcvSize);
+        if (status == NNG_ETIMEDOUT) {
+            done = finished;
+            continue;
+        }
+        checkstat(status, "Failed to receive a message");
+        TraceScope trace("process");
+        done = countMessage(pMsg);
+        nng_free(pMsg, rcvSize);
+    }
+}
+
+/**
+ * loopHandler
+ *    EventLoop handler: the same accounting as threadReceiver.
+ */
+static bool
+loopHandler(nng_msg* pMsg, void* pArg) {
+    bool end = countMessage(nng_msg_body(pMsg));
+    nng_msg_free(pMsg);
+    return !end;
+}
+
+/**
+ * sender
+ *    Send the data and, for pub, the end messages.
+ *
+ * @param s          - listening push or pub socket.
+ * @param nmsg       - number of data messages.
+ * @param msgSize    - message size.
+ * @param pub        - true if publishing.
+ * @param nendpoints - number of subscribers that must see an end.
+ */
+static void
+sender(nng_socket s, size_t nmsg, size_t msgSize, bool pub, size_t nendpoints) {
+    uint8_t* pMessage = new uint8_t[msgSize];
+    memset(pMessage, 0, msgSize);
+
+    for (int i = 0; i < nmsg; i++) {
+        checkstat(
+            tracedSend(s, pMessage, msgSize, 0),
+            "Failed to send a message"
+        );
+    }
+    if (pub) {
+        pMessage[0] = 1;
+        while (endpointsDone < nendpoints) {
+            checkstat(
+                tracedSend(s, pMessage, msgSize, 0),
+                "Failed to publish an end message"
+            );
+            usleep(1000);
+        }
+    } else {
+        while (received < nmsg) {
+            usleep(100);
+        }
+    }
+    delete []pMessage;
+}
+
+/**
+ *  Entry point:
+ *
+ * @note
+ *    This is not production code so segfaults will likely happen
+ * if paramteers are missing.  See Usage at the start of the file.
+ */
+int main(int argc, char** argv) {
+    std::string uri(argv[1]);
+    bool   pub        = std::string(argv[2]) == "pub";
+    size_t nendpoints = atol(argv[3]);
+    size_t nmsg       = atol(argv[4]);
+    size_t msgSize    = atol(argv[5]);
+    bool   loop       = std::string(argv[6]) == "loop";
+    size_t ndispatch  = (argc > 7) ? atol(argv[7]) : 1;
+    nng_socket s;
+    std::vector<nng_socket>   endpoints;
+    std::vector<std::thread*> threads;
+    EventLoop* pLoop(nullptr);
+
+    if (msgSize < 1) msgSize = 1;             // Room for the end flag.
+
+    if (pub) {
+        checkstat(nng_pub0_open(&s), "Publisher could not open socket");
+    } else {
+        checkstat(nng_push0_open(&s), "Unable to create push socket.");
+    }
+    checkstat(
+        perfListen(s, uri.c_str(), nullptr, 0),
+        "Sender could not start listening"
+    );
+
+    long rssBefore = rssKB();
+    if (loop) {
+        pLoop = new EventLoop(ndispatch);
+    }
+    for (int i = 0; i < nendpoints; i++) {
+        nng_socket es = openEndpoint(uri, pub);
+        endpoints.push_back(es);
+        if (loop) {
+            pLoop->addReceiver(es, loopHandler, nullptr);
+        } else {
+            threads.push_back(new std::thread(threadReceiver, es));
+        }
+    }
+    sleep(1 + nendpoints/1000);              // Let the connections settle.
+    long rssAfter = rssKB();
+    int  nthreads = threadCount();
+
+    double cpuStart = cpuSeconds();
+    auto start = std::chrono::high_resolution_clock::now();
+    sender(s, nmsg, msgSize, pub, nendpoints);
+    auto end = std::chrono::high_resolution_clock::now();
+    double cpu = cpuSeconds() - cpuStart;
+
+    // Shut the endpoints down.
+
+    if (loop) {
+        for (auto es : endpoints) {
+            nng_close(es);
+        }
+        pLoop->wait();
+        delete pLoop;
+    } else {
+        finished = true;
+        for (auto p : threads) {
+            p->join();
+            delete p;
+        }
+        for (auto es : endpoints) {
+            nng_close(es);
+        }
+    }
+    nng_close(s);
+
+    double secs = (double)std::chrono::duration_cast<std::chrono::microseconds>(end - start).count()/1.0e6;
+    double delivered = received;
+    double expected  = pub ? (double)nmsg * nendpoints : nmsg;
+
+    std::cout << (pub ? "Subscribers: " : "Pullers: ") << nendpoints
+              << (loop ? " event loop" : " thread each") << std::endl;
+    std::cout << "Time:               " << secs << std::endl;
+    std::cout << "Delivered msgs/sec: " << delivered/secs << std::endl;
+    std::cout << "Delivered KB/sec:   " << delivered*msgSize/secs/1024.0 << std::endl;
+    std::cout << "Delivered %:        " << 100.0*delivered/expected << std::endl;
+    std::cout << "CPU sec:            " << cpu << std::endl;
+    std::cout << "CPU us/msg:         " << (delivered > 0 ? 1.0e6*cpu/delivered : 0.0) << std::endl;
+    std::cout << "CPU/wall:           " << cpu/secs << std::endl;
+    std::cout << "Threads:            " << nthreads << std::endl;
+    std::cout << "RSS KB/endpoint:    " << (double)(rssAfter - rssBefore)/nendpoints << std::endl;
+
+    return EXIT_SUCCESS;
+}
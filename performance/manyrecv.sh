@@ -0,0 +1,20 @@
+#!/bin/bash
+
+# Thread per endpoint vs. an event loop as the number of pullers and
+# subscribers grows.  Each endpoint is a socket so raise the fd limit.
+
+ulimit -n 20000
+
+echo Many receivers log > manyrecv.log
+
+for n in 10 100 1000 5000
+do
+    for mode in threads loop
+    do
+	echo ---- push $n pullers $mode -------- >> manyrecv.log
+	./manyrecv tcp://localhost:3000 push $n 1000000 100 $mode >> manyrecv.log
+
+	echo ---- pub $n subscribers $mode -------- >> manyrecv.log
+	./manyrecv tcp://localhost:3001 pub $n 1000 100 $mode >> manyrecv.log
+    done
+done
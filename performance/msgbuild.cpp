@@ -0,0 +1,207 @@
+/**
+ * This program measures the message building cost of the example
+ * programs before and after they were ported to the helper library
+ * (../nngutil.h).
+ *
+ * Usage:
+ *     msgbuild uri nmsg
+ *
+ * Where uri  - is a URI used for the push/pull phase.
+ *       nmsg - is the number of messages sent in each phase.
+ *
+ * Phases:
+ *   push (old)      - push.cpp's original loop: std::stringstream then
+ *                     nng_msg_alloc(n) + nng_msg_insert(n) + nng_sendmsg.
+ *   push (new)      - push.cpp's loop now: MessageBuilder::format + send.
+ *   publisher (old) - publisher.cpp's original publish(): three
+ *                     stringstream formatted messages, alloc + insert.
+ *   publisher (new) - publish() with MessageBuilder::format.
+ *
+ * The push phases have a pull thread draining the messages so the
+ * timing includes the transport.  The publisher phases have no
+ * subscribers (pub discards the messages) which isolates the cost of
+ * building and handing off the messages - the part that changed.
+ *
+ * Note the new phases gain from removing the double allocation only.
+ * Sent messages belong to nng, so nothing is recycled into the builder's
+ * pool and every format still allocates one nng_msg.
+ *
+ * Output is seconds and msgs/sec for each phase.
+ */
+#include <thread>
+#include <nng/nng.h>
+#include <nng/protocol/pipeline0/push.h>
+#include <nng/protocol/pipeline0/pull.h>
+#include <nng/protocol/pubsub0/pub.h>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <chrono>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "../nngutil.h"
+#include "trace.h"
+
+using namespace nngutil;
+
+/**
+ * oldSend
+ *    The send() helper the examples used to have.
+ * @param s   - socket.
+ * @param msg - string to send (with its null terminator).
+ */
+static void
+oldSend(nng_socket s, const std::string& msg) {
+    nng_msg* pMsg;
+    auto l = msg.size() + 1;
+
+    checkstat(
+        nng_msg_alloc(&pMsg, l),
+        "Failed to allocate message"
+    );
+    checkstat(
+        nng_msg_insert(pMsg, msg.c_str(), l),
+        "Failed to encapsulate message"
+    );
+    TraceScope trace("send", traceNextSend());
+    checkstat(
+        nng_sendmsg(s, pMsg, 0),
+        "Failed to send message"
+    );
+}
+
+/**
+ * newSend
+ *    Socket::send traced like oldSend.
+ */
+static void
+newSend(Socket& s, Message&& msg) {
+    TraceScope trace("send", traceNextSend());
+    s.send(std::move(msg));
+}
+
+/**
+ * drain
+ *    Pull thread: receive nmsg messages.
+ */
+static void
+drain(std::string uri, size_t nmsg) {
+    Socket s(nng_pull0_open, "Unable to open a pull socket.");
+    s.dial(uri.c_str(), "Puller dial failed");
+    for (int i = 0; i < nmsg; i++) {
+        TraceScope trace("recv", traceNextRecv());
+        Message msg = s.recv("Pull of data failed.");
+    }
+}
+
+static void
+oldPush(Socket& s, size_t nmsg, MessageBuilder&) {
+    for (int seq = 0; seq < nmsg; seq++) {
+        std::stringstream strmessage;
+        strmessage << "message number " << seq;
+        oldSend(s, strmessage.str());
+    }
+}
+
+static void
+newPush(Socket& s, size_t nmsg, MessageBuilder& builder) {
+    for (int seq = 0; seq < nmsg; seq++) {
+        newSend(s, builder.format("message number %d", seq));
+    }
+}
+
+// nmsg is rounded down to a multiple of the 3 messages publish() sends.
+
+static void
+oldPublish(Socket& s, size_t nmsg, MessageBuilder&) {
+    const char* name = "msgbuild";
+    for (int i = 0; i < nmsg/3; i++) {
+        std::stringstream namemsg;
+        namemsg << "NAME" << " " << name;
+        oldSend(s, namemsg.str());
+
+        std::stringstream pidmsg;
+        pidmsg <<  "PID" << " " << getpid();
+        oldSend(s, pidmsg.str());
+
+        time_t t = time(nullptr);
+        std::stringstream timemsg;
+        timemsg << "TIME" << " " << ctime(&t);
+        oldSend(s, timemsg.str());
+    }
+}
+
+static void
+newPublish(Socket& s, size_t nmsg, MessageBuilder& builder) {
+    const char* name = "msgbuild";
+    for (int i = 0; i < nmsg/3; i++) {
+        newSend(s, builder.format("NAME %s", name));
+        newSend(s, builder.format("PID %d", getpid()));
+        time_t t = time(nullptr);
+        newSend(s, builder.format("TIME %s", ctime(&t)));
+    }
+}
+
+/**
+ * phase
+ *    Time one loop and report it.
+ * @param title - heading.
+ * @param loop  - the send loop.
+ * @param s     - socket to send on.
+ * @param nmsg  - messages to send.
+ * @param pDrain - if not null a drain thread to join inside the timing.
+ */
+static void
+phase(
+    const char* title, void (*loop)(Socket&, size_t, MessageBuilder&),
+    Socket& s, size_t nmsg, std::thread* pDrain = nullptr
+) {
+    MessageBuilder builder;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    loop(s, nmsg, builder);
+    if (pDrain) {
+        pDrain->join();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    double secs = (double)std::chrono::duration_cast<std::chrono::microseconds>(end - start).count()/1.0e6;
+    std::cout << title << std::endl;
+    std::cout << "Time:       " << secs << std::endl;
+    std::cout << "msgs/sec:   " << (double)nmsg/secs << std::endl;
+}
+
+/**
+ *  Entry point
+ * @note - this is not production code so missing command line
+ * parameters most likely result in a segfault.
+ */
+int main(int argc, char** argv) {
+    std::string uri(argv[1]);
+    size_t nmsg = atol(argv[2]);
+
+    // Push phases - fresh socket and puller for each.
+
+    for (int i = 0; i < 2; i++) {
+        Socket s(nng_push0_open, "Unable to create push socket.");
+        s.listen(uri.c_str(), "Unable to start pusher listening.");
+        std::thread puller(drain, uri, nmsg);
+        sleep(1);                        // Let it dial.
+        if (i == 0) {
+            phase("push (old)", oldPush, s, nmsg, &puller);
+        } else {
+            phase("push (new)", newPush, s, nmsg, &puller);
+        }
+    }
+
+    // Publisher phases - no subscribers.
+
+    Socket pub(nng_pub0_open, "Publisher could not open socket");
+    phase("publisher (old)", oldPublish, pub, (nmsg/3)*3);
+    phase("publisher (new)", newPublish, pub, (nmsg/3)*3);
+
+    return EXIT_SUCCESS;
+}
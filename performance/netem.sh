@@ -0,0 +1,60 @@
+#!/bin/bash
+
+# Emulated WAN for the benchmarks (see netns.h).  Needs root.
+#
+#   netem.sh up [delay_ms [jitter_ms [loss% [rate]]]]
+#   netem.sh down
+#   netem.sh show
+#
+# up makes the network namespace nngwan joined to this one by the veth
+# pair nngwan0 (here, 10.77.0.1) - nngwan1 (nngwan, 10.77.0.2) and puts
+# a netem qdisc on both ends.  delay and jitter are per direction so the
+# round trip time is twice the delay.  rate is a tc rate, e.g. 1gbit.
+# Running up again replaces the conditions.  Then run a benchmark with
+#
+#   PERF_NETNS=nngwan ./reqrep tcp://10.77.0.2:3000 ...
+
+NS=nngwan
+HOST_IF=nngwan0
+NS_IF=nngwan1
+
+netem() {
+    args="delay ${1:-0}ms"
+    if [ -n "$2" ] && [ "$2" != "0" ]; then args="$args ${2}ms distribution normal"; fi
+    if [ -n "$3" ] && [ "$3" != "0" ]; then args="$args loss $3%"; fi
+    if [ -n "$4" ]; then args="$args rate $4"; fi
+    echo $args
+}
+
+case "$1" in
+up)
+    if ! ip netns list | grep -qw $NS
+    then
+	ip netns add $NS
+	ip link add $HOST_IF type veth peer name $NS_IF
+	ip link set $NS_IF netns $NS
+	ip addr add 10.77.0.1/24 dev $HOST_IF
+	ip link set $HOST_IF up
+	ip netns exec $NS ip addr add 10.77.0.2/24 dev $NS_IF
+	ip netns exec $NS ip link set $NS_IF up
+	ip netns exec $NS ip link set lo up
+    fi
+    conditions=$(netem $2 $3 $4 $5)
+    tc qdisc replace dev $HOST_IF root netem $conditions
+    ip netns exec $NS tc qdisc replace dev $NS_IF root netem $conditions
+    echo "$NS up: $conditions each way"
+    ;;
+down)
+    ip link del $HOST_IF 2> /dev/null
+    ip netns del $NS 2> /dev/null
+    ;;
+show)
+    tc qdisc show dev $HOST_IF
+    ip netns exec $NS tc qdisc show dev $NS_IF
+    ping -c 5 -q 10.77.0.2
+    ;;
+*)
+    echo "Usage: netem.sh up [delay_ms [jitter_ms [loss% [rate]]]] | down | show"
+    exit 1
+    ;;
+esac
@@ -0,0 +1,73 @@
+/**
+ * Listening in an emulated WAN.
+ *
+ * Over localhost TCP there is no latency, loss or bandwidth limit to
+ * speak of.  netem.sh makes a network namespace joined to this one by a
+ * veth pair with tc netem on both ends.  With
+ *
+ *   PERF_NETNS=name  - the namespace (e.g. nngwan, see netem.sh)
+ *
+ * set, perfListen makes its listening socket inside that namespace and
+ * then puts the calling thread back.  Connections accepted by the
+ * listener stay in the namespace while the dialers are in this one, so
+ * every connection a benchmark makes crosses the veth pair (and
+ * netem) as long as the URI uses the namespace's address, e.g.
+ * tcp://10.77.0.2:3000.  netem is applied in both directions so it makes
+ * no difference whether the listener is the sending or receiving side.
+ * ipc:// and inproc:// are not affected.
+ *
+ * Only the listen is moved: nng makes dialing sockets on its own
+ * threads, which stay in this namespace.  Entering a namespace needs
+ * CAP_SYS_ADMIN.
+ */
+#ifndef NETNS_H
+#define NETNS_H
+
+#include <nng/nng.h>
+
+#include <iostream>
+#include <string>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * perfListen
+ *    nng_listen, in the PERF_NETNS namespace if one is set.
+ *
+ * @return int - nng status.
+ */
+static inline int
+perfListen(nng_socket s, const char* uri, nng_listener* pListener, int flags) {
+    const char* name = getenv("PERF_NETNS");
+    if (!name) {
+        return nng_listen(s, uri, pListener, flags);
+    }
+    std::string path = std::string("/var/run/netns/") + name;
+    int home = open("/proc/thread-self/ns/net", O_RDONLY);
+    int target = open(path.c_str(), O_RDONLY);
+    if (home < 0 || target < 0) {
+        std::cerr << "Unable to open network namespace " << path << ": "
+                  << strerror(errno) << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (setns(target, CLONE_NEWNET)) {
+        std::cerr << "Unable to enter network namespace " << name << ": "
+                  << strerror(errno) << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    int status = nng_listen(s, uri, pListener, flags);
+    if (setns(home, CLONE_NEWNET)) {
+        std::cerr << "Unable to leave network namespace " << name << ": "
+                  << strerror(errno) << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    close(target);
+    close(home);
+    return status;
+}
+
+#endif
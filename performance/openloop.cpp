@@ -0,0 +1,474 @@
+/**
+ *  This program is an open loop load generator for every pattern.  The
+ * other benchmarks are closed loop - each send waits for the last one
+ * so when the receivers fall behind the sender just slows down and the
+ * queueing never shows up in the latency (coordinated omission).  Here
+ * sends are made on a schedule fixed in advance, whether or not the
+ * previous ones have got through, and latency is measured from the
+ * scheduled send time rather than the time the send actually happened.
+ *
+ *   Usage:
+ *      openloop URI pattern nreceivers rate nmsgs size [dist [pacing]]
+ *
+ *   Where:
+ *     URI        - is the URI the sender listens on; the receivers dial.
+ *     pattern    - pair   - one pair receiver (nreceivers is forced to 1).
+ *                  push   - nreceivers pullers.
+ *                  pub    - nreceivers subscribers.
+ *                  bus    - nreceivers bus members.
+ *                  req    - requests to a REP socket served by nreceivers
+ *                           contexts; latency is to the reply.
+ *                  survey - surveys of nreceivers respondents; latency is
+ *                           to each response.
+ *     nreceivers - number of receivers (see above).
+ *     rate       - offered messages (requests, surveys) per second.
+ *     nmsgs      - how many to send.
+ *     size       - message size in bytes (at least 16).
+ *     dist       - fixed   - (default) evenly spaced sends.
+ *                  poisson - exponentially distributed gaps with the same
+ *                            mean (a Poisson arrival process).
+ *     pacing     - timerfd - (default) sleep on an absolute timerfd.
+ *                  spin    - spin on the clock; more precise, burns a CPU.
+ *
+ *   Each message carries its sequence number and scheduled send time.
+ *   One way patterns block in nng_send when nng does; the sends after
+ *   that are late and their latency includes the lateness.  req and
+ *   survey can't wait for an answer before the next send so each send
+ *   takes a free context (more are opened as needed) and the replies are
+ *   handled in aio callbacks.
+ *
+ *   Output:
+ *     - Achieved send rate and the sender's worst lateness against the
+ *       schedule.
+ *     - Deliveries (replies, responses) received out of those expected.
+ *     - Latency from the scheduled time p50/p90/p99/p99.9/max.
+ */
+#include <thread>
+#include <nng/nng.h>
+#include <nng/protocol/pair0/pair.h>
+#include <nng/protocol/pipeline0/push.h>
+#include <nng/protocol/pipeline0/pull.h>
+#include <nng/protocol/pubsub0/pub.h>
+#include <nng/protocol/pubsub0/sub.h>
+#include <nng/protocol/bus0/bus.h>
+#include <nng/protocol/reqrep0/req.h>
+#include <nng/protocol/reqrep0/rep.h>
+#include <nng/protocol/survey0/survey.h>
+#include <nng/protocol/survey0/respond.h>
+
+#include <iostream>
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/timerfd.h>
+
+#include "recvmode.h"
+#include "netns.h"
+#include "perfutil.h"
+
+
+/**
+ * Pacer
+ *    Waits for absolute CLOCK_MONOTONIC times by timerfd or spinning.
+ */
+class Pacer {
+public:
+    explicit Pacer(bool spin) : m_spin(spin), m_fd(-1) {
+        if (!spin) {
+            m_fd = timerfd_create(CLOCK_MONOTONIC, 0);
+            if (m_fd < 0) {
+                perror("timerfd_create failed");
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+    ~Pacer() {
+        if (m_fd >= 0) close(m_fd);
+    }
+    void waitUntil(uint64_t t) {
+        if (m_spin) {
+            while (now() < t)
+                ;
+            return;
+        }
+        if (t <= now()) return;                  // Already late.
+        struct itimerspec when;
+        memset(&when, 0, sizeof(when));
+        when.it_value.tv_sec  = t / 1000000000;
+        when.it_value.tv_nsec = t % 1000000000;
+        timerfd_settime(m_fd, TFD_TIMER_ABSTIME, &when, nullptr);
+        uint64_t expirations;
+        read(m_fd, &expirations, sizeof(expirations));
+    }
+private:
+    bool m_spin;
+    int  m_fd;
+};
+
+/**
+ *  What each message starts with.
+ */
+struct Stamp {
+    uint64_t seq;
+    uint64_t scheduled;
+};
+
+// Latencies from wherever they're measured (receiver threads or aio
+// callbacks) go into one preallocated array.
+
+static std::vector<uint64_t>  latencies;
+static std::atomic<size_t>    nlatencies(0);
+static std::atomic<size_t>    errors(0);
+static std::atomic<bool>      finished(false);
+
+/**
+ * record
+ *    Record the latency of a delivery given the message body.
+ */
+static void
+record(const void* pBody) {
+    uint64_t at = now();
+    Stamp stamp;
+    memcpy(&stamp, pBody, sizeof(stamp));
+    TraceScope trace("process", stamp.seq);
+    size_t i = nlatencies.fetch_add(1, std::memory_order_relaxed);
+    if (i < latencies.size()) {
+        latencies[i] = at - stamp.scheduled;
+    }
+}
+
+/**
+ * oneWayReceiver
+ *    pair/push/pub/bus receiver: record each message until finished.
+ */
+static void
+oneWayReceiver(nng_socket s) {
+    void*  pMsg;
+    size_t size;
+    perfReceiverSetup();
+    while (true) {
+        int status = perfRecv(s, &pMsg, &size);
+        if (status == NNG_ETIMEDOUT) {
+            if (finished) break;
+            continue;
+        }
+        checkstat(status, "Receiver failed to receive");
+        record(pMsg);
+        nng_free(pMsg, size);
+    }
+}
+
+/**
+ * respondent
+ *    Echo surveys back until finished.
+ */
+static void
+respondent(nng_socket s) {
+    void*  pMsg;
+    size_t size;
+    perfReceiverSetup();
+    while (true) {
+        int status = perfRecv(s, &pMsg, &size);
+        if (status == NNG_ETIMEDOUT) {
+            if (finished) break;
+            continue;
+        }
+        checkstat(status, "Respondent failed to receive");
+        status = tracedSend(s, pMsg, size, NNG_FLAG_ALLOC);   // Takes pMsg.
+        if (status) {
+            nng_free(pMsg, size);
+            errors++;
+        }
+    }
+}
+
+/**
+ * replier
+ *    Echo requests on one context of the REP socket until it's closed.
+ */
+static void
+replier(nng_socket s) {
+    nng_ctx  ctx;
+    nng_aio* pAio;
+    checkstat(nng_ctx_open(&ctx, s), "Unable to open a reply context");
+    checkstat(nng_aio_alloc(&pAio, nullptr, nullptr), "Unable to allocate an aio");
+    while (true) {
+        nng_ctx_recv(ctx, pAio);
+        nng_aio_wait(pAio);
+        int status = nng_aio_result(pAio);
+        if (status == NNG_ECLOSED) break;
+        checkstat(status, "Could not receive a request");
+
+        nng_aio_set_msg(pAio, nng_aio_get_msg(pAio));
+        nng_ctx_send(ctx, pAio);
+        nng_aio_wait(pAio);
+        status = nng_aio_result(pAio);
+        if (status) {
+            nng_msg_free(nng_aio_get_msg(pAio));
+            if (status == NNG_ECLOSED) break;
+            errors++;
+        }
+    }
+    nng_aio_free(pAio);
+}
+
+/**
+ *  An outstanding request or survey: a context and its aio.
+ */
+struct Slot {
+    nng_ctx  ctx;
+    nng_aio* pAio;
+    bool     sending;                  // Send not yet complete.
+    size_t   responses;
+};
+
+static std::mutex          slotLock;
+static std::vector<Slot*>  allSlots;
+static std::vector<Slot*>  freeSlots;
+static std::atomic<size_t> outstanding(0);
+static bool                surveying;
+static size_t              nreceivers;
+
+static void
+releaseSlot(Slot* pSlot) {
+    std::lock_guard<std::mutex> l(slotLock);
+    freeSlots.push_back(pSlot);
+    outstanding--;
+}
+
+/**
+ * slotCallback
+ *    Send done -> start the receive; receive done -> record and, for a
+ *  survey with responses still to come, receive again.
+ */
+static void
+slotCallback(void* arg) {
+    Slot* pSlot = reinterpret_cast<Slot*>(arg);
+    int status = nng_aio_result(pSlot->pAio);
+    if (pSlot->sending) {
+        if (status) {
+            nng_msg_free(nng_aio_get_msg(pSlot->pAio));
+            errors++;
+            releaseSlot(pSlot);
+            return;
+        }
+        pSlot->sending = false;
+        nng_ctx_recv(pSlot->ctx, pSlot->pAio);
+        return;
+    }
+    if (status == 0) {
+        nng_msg* pMsg = nng_aio_get_msg(pSlot->pAio);
+        record(nng_msg_body(pMsg));
+        nng_msg_free(pMsg);
+        if (surveying && ++pSlot->responses < nreceivers) {
+            nng_ctx_recv(pSlot->ctx, pSlot->pAio);
+            return;
+        }
+    } else if (!(surveying && (status == NNG_ETIMEDOUT || status == NNG_ESTATE))) {
+        if (status != NNG_ECLOSED) errors++;
+    }
+    releaseSlot(pSlot);
+}
+
+/**
+ * asyncSend
+ *    Start a request or survey on a free context.
+ */
+static void
+asyncSend(nng_socket s, const uint8_t* pData, size_t size) {
+    Slot* pSlot;
+    {
+        std::lock_guard<std::mutex> l(slotLock);
+        if (freeSlots.empty()) {
+            pSlot = new Slot;
+            checkstat(nng_ctx_open(&pSlot->ctx, s), "Unable to open a context");
+            checkstat(
+                nng_aio_alloc(&pSlot->pAio, slotCallback, pSlot),
+                "Unable to allocate an aio"
+            );
+            allSlots.push_back(pSlot);
+        } else {
+            pSlot = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        outstanding++;
+    }
+    nng_msg* pMsg;
+    checkstat(nng_msg_alloc(&pMsg, size), "Unable to allocate a message");
+    memcpy(nng_msg_body(pMsg), pData, size);
+    pSlot->sending   = true;
+    pSlot->responses = 0;
+    nng_aio_set_msg(pSlot->pAio, pMsg);
+    nng_ctx_send(pSlot->ctx, pSlot->pAio);
+}
+
+/**
+ *  Entry point
+ * @note - this is not production code so missing command line
+ * parameters most likely result in a segfault.
+ */
+int main(int argc, char** argv) {
+    std::string uri(argv[1]);
+    std::string pattern(argv[2]);
+    nreceivers     = atol(argv[3]);
+    double rate    = atof(argv[4]);
+    size_t nmsg    = atol(argv[5]);
+    size_t msgSize = atol(argv[6]);
+    bool poisson   = (argc > 7) && (std::string(argv[7]) == "poisson");
+    bool spin      = (argc > 8) && (std::string(argv[8]) == "spin");
+
+    if (pattern == "pair") nreceivers = 1;
+    if (msgSize < sizeof(Stamp)) msgSize = sizeof(Stamp);
+    bool async   = pattern == "req" || pattern == "survey";
+    bool fanout  = pattern == "pub" || pattern == "bus" || pattern == "survey";
+    surveying    = pattern == "survey";
+    size_t expected = fanout ? nmsg * nreceivers : nmsg;
+    latencies.resize(expected);
+
+    // The sender listens:
+
+    nng_socket s;
+    if      (pattern == "pair")   checkstat(nng_pair0_open(&s), "Unable to open pair socket");
+    else if (pattern == "push")   checkstat(nng_push0_open(&s), "Unable to open push socket");
+    else if (pattern == "pub")    checkstat(nng_pub0_open(&s), "Unable to open pub socket");
+    else if (pattern == "bus")    checkstat(nng_bus0_open(&s), "Unable to open bus socket");
+    else if (pattern == "req")    checkstat(nng_req0_open(&s), "Unable to open req socket");
+    else if (pattern == "survey") checkstat(nng_surveyor0_open(&s), "Unable to open surveyor socket");
+    else {
+        std::cerr << "Unknown pattern " << pattern << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (surveying) {
+        checkstat(
+            nng_setopt_ms(s, NNG_OPT_SURVEYOR_SURVEYTIME, 1000),
+            "Failed to set survey time"
+        );
+    }
+    checkstat(
+        perfListen(s, uri.c_str(), nullptr, 0),
+        "Sender could not listen"
+    );
+
+    // The receivers dial.  For req it's one REP socket with a context
+    // per receiver.
+
+    std::vector<nng_socket>   receivers;
+    std::vector<std::thread*> threads;
+    if (pattern == "req") {
+        nng_socket rep;
+        checkstat(nng_rep0_open(&rep), "Unable to open rep socket");
+        checkstat(nng_dial(rep, uri.c_str(), nullptr, 0), "Replier could not dial");
+        receivers.push_back(rep);
+        for (int i = 0; i < nreceivers; i++) {
+            threads.push_back(new std::thread(replier, rep));
+        }
+    } else {
+        for (int i = 0; i < nreceivers; i++) {
+            nng_socket r;
+            if      (pattern == "pair")   checkstat(nng_pair0_open(&r), "Unable to open pair socket");
+            else if (pattern == "push")   checkstat(nng_pull0_open(&r), "Unable to open pull socket");
+            else if (pattern == "bus")    checkstat(nng_bus0_open(&r), "Unable to open bus socket");
+            else if (pattern == "survey") checkstat(nng_respondent0_open(&r), "Unable to open respondent socket");
+            else {
+                checkstat(nng_sub0_open(&r), "Unable to open sub socket");
+                checkstat(nng_setopt(r, NNG_OPT_SUB_SUBSCRIBE, "", 0), "Could not subscribe");
+            }
+            checkstat(nng_setopt_ms(r, NNG_OPT_RECVTIMEO, 100), "Unable to set receive timeout");
+            checkstat(nng_dial(r, uri.c_str(), nullptr, 0), "Receiver could not dial");
+            receivers.push_back(r);
+            threads.push_back(new std::thread(surveying ? respondent : oneWayReceiver, r));
+        }
+    }
+    sleep(1);                                 // Let everyone connect.
+
+    // Offer the load:
+
+    Pacer pacer(spin);
+    std::mt19937_64 gen(1);
+    std::exponential_distribution<double> gap(rate);
+    uint8_t* pMessage = new uint8_t[msgSize];
+    memset(pMessage, 0, msgSize);
+    uint64_t worstLate = 0;
+    uint64_t start = now() + 10*1000*1000;
+    uint64_t scheduled = start;
+
+    for (int i = 0; i < nmsg; i++) {
+        if (poisson) {
+            scheduled += static_cast<uint64_t>(gap(gen) * 1.0e9);
+        } else {
+            scheduled = start + static_cast<uint64_t>(i * 1.0e9 / rate);
+        }
+        pacer.waitUntil(scheduled);
+        worstLate = std::max(worstLate, now() - scheduled);
+
+        Stamp stamp = {static_cast<uint64_t>(i), scheduled};
+        memcpy(pMessage, &stamp, sizeof(stamp));
+        if (async) {
+            asyncSend(s, pMessage, msgSize);
+        } else {
+            checkstat(tracedSend(s, pMessage, msgSize, 0, i), "Failed to send");
+        }
+    }
+    uint64_t sendEnd = now();
+    delete []pMessage;
+
+    // Drain: wait until everything expected is in, or for 2 seconds
+    // without progress (drops, lost surveys).
+
+    size_t lastCount = 0;
+    uint64_t lastProgress = now();
+    while (true) {
+        size_t count = nlatencies;
+        bool idle = !async || outstanding == 0;
+        if (count >= expected && idle) break;
+        if (count != lastCount) {
+            lastCount = count;
+            lastProgress = now();
+        } else if (now() - lastProgress > 2000ull*1000*1000) {
+            break;
+        }
+        usleep(1000);
+    }
+
+    finished = true;
+    nng_close(s);
+    if (pattern == "req") nng_close(receivers[0]);
+    for (auto p : threads) {
+        p->join();
+        delete p;
+    }
+    if (pattern != "req") {
+        for (auto r : receivers) nng_close(r);
+    }
+    for (auto pSlot : allSlots) {
+        nng_aio_free(pSlot->pAio);
+        delete pSlot;
+    }
+
+    size_t delivered = std::min(nlatencies.load(), expected);
+    latencies.resize(delivered);
+    std::sort(latencies.begin(), latencies.end());
+    double secs = (sendEnd - start)/1.0e9;
+
+    std::cout << pattern << " receivers " << nreceivers << " offered " << rate << "/sec "
+              << (poisson ? "poisson" : "fixed") << " " << (spin ? "spin" : "timerfd") << std::endl;
+    std::cout << "Achieved sends/sec:      " << nmsg/secs << std::endl;
+    std::cout << "Worst send lateness (us): " << worstLate/1000.0 << std::endl;
+    std::cout << "Delivered:               " << delivered << " of " << expected << std::endl;
+    std::cout << "Errors:                  " << errors << std::endl;
+    std::cout << "Contexts used:           " << allSlots.size() << std::endl;
+    std::cout << "Latency from schedule (us) p50:   " << percentile(latencies, 50.0) << std::endl;
+    std::cout << "Latency from schedule (us) p90:   " << percentile(latencies, 90.0) << std::endl;
+    std::cout << "Latency from schedule (us) p99:   " << percentile(latencies, 99.0) << std::endl;
+    std::cout << "Latency from schedule (us) p99.9: " << percentile(latencies, 99.9) << std::endl;
+    std::cout << "Latency from schedule (us) max:   " << (latencies.empty() ? 0.0 : latencies.back()/1000.0) << std::endl;
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,20 @@
+#!/bin/bash
+
+# Open loop latency: each pattern at rising offered rates, evenly spaced
+# and Poisson.  Latency is from the scheduled send time so the knee where
+# the offered rate passes what the pattern can carry shows up as the
+# tail latency running away.
+
+echo Open loop log > openloop.log
+
+for pattern in pair push pub bus req survey
+do
+    for rate in 1000 10000 50000 100000 200000
+    do
+	for dist in fixed poisson
+	do
+	    echo ---- $pattern $rate/sec $dist -------- >> openloop.log
+	    ./openloop tcp://localhost:3000 $pattern 4 $rate $((rate * 5)) 100 $dist >> openloop.log
+	done
+    done
+done
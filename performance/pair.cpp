@@ -1,10 +1,17 @@
 // Measure the performance of sending messages on a pair socket
 // with nng.  Usage:
-//    pair uri nmsg msgsize
+//    pair uri nmsg msgsize [duplex [acksize] | streams nstreams]
 //  
 //      uri - the URI on which both sender and receiver connect.
 //      nmsg - Number of messages.
 //      msgsize - size in bytes of each message to be sent.
+//      duplex - if present, both ends send and receive at the same time
+//               see "Full duplex" below.
+//      acksize - In duplex mode, the size of the messages sent in the
+//               reverse direction (default msgsize).  A small acksize
+//               models data one way and acknowledgements the other.
+//      streams - if present, run nstreams independent pairs at once;
+//               uri then has a %d for the stream number (see streams.h).
 //
 //  The way this, and all of our performance measures works is
 // a reeiver thread is started and listens on the URI
@@ -28,8 +35,23 @@
 //
 // Then we exit.
 //
+// Full duplex:
+//   Each end of the pair gets a sender thread and a receiver thread.
+//   The listener end sends nmsg acksize messages to the dialer end while
+//   the dialer end sends nmsg msgsize messages to the listener end.
+//   Each receiver notes when it got its last message; the time and rates
+//   for each direction are reported from the common start along with the
+//   aggregate over both directions.  If one direction starves the other
+//   it shows up as very different per direction times.
+//
+// Streams:
+//   Each stream is a listener and a dialer socket with a receiver thread
+//   and a sender thread sending nmsg msgsize messages.  Per stream and
+//   aggregate rates are reported.
+//
 
 #include <thread>
+#include <functional>
 #include <nng/nng.h>
 #include <nng/protocol/pair0/pair.h>
 
@@ -37,24 +59,16 @@
 #include <chrono>
 #include <stdlib.h>
 #include <unistd.h>
+#include <string>
+#include <algorithm>
+#include <vector>
 
+#include "recvmode.h"
+#include "netns.h"
+#include "sendbuffer.h"
+#include "streams.h"
+#include "perfutil.h"
 
-/**
- * checkstat
- *    Check the status of an nng call and output a message/exit
- * if the result is not ok.
- * 
- * @param status - nng status returned from a call.
- * @param doing  - text that will describe what failed.
- * 
- */
-static void 
-checkstat(int status,  const char* doing) {
-    if (status) {
-        std::cerr << doing << ": " << nng_strerror(status) << std::endl;
-        exit(EXIT_FAILURE);
-    }
-}
 
 /**
  * The receiver thread:
@@ -76,6 +90,7 @@ receiver(std::string uri, size_t nmsg) {
     nng_socket s;
     void* pData;                      // Where data goes.
     size_t rcvSize;
+    perfReceiverSetup();
 
     // Set up our side of the pair:
 
@@ -84,14 +99,14 @@ receiver(std::string uri, size_t nmsg) {
         "Creating the receiver socket."
     );
     checkstat(
-        nng_listen(s, uri.c_str(), nullptr, 0),
+        perfListen(s, uri.c_str(), nullptr, 0),
         "Receiver listening on socket."
     );
     // Receive the data:
 
     for (int i=0; i < nmsg; i++) {
         checkstat(
-            nng_recv(s, &pData, &rcvSize, NNG_FLAG_ALLOC),
+            perfRecv(s, &pData, &rcvSize),
             "Receiver receiving a message"
         );
         nng_free(pData, rcvSize);                            // Release dynamic storage.
@@ -100,26 +115,201 @@ receiver(std::string uri, size_t nmsg) {
 }
 
 /**
- * The sender:   Given a socket sends the message and then returns.
- * 
+ * sendFrom
+ *    Send nmsg messages from one buffer.
+ *
  * @param[in] s - the socket on which to send.
  * @param[in] nmsg - The number of messages to send.
  * @param[in] size - the message size in bytes.
- * 
- * @note - we only allocate the message buffer once and it
- *        just has crap so we are timing the sends only.
+ * @param[in] buffer - at least size bytes (see sendbuffer.h).
  */
-void
-sender(nng_socket s, size_t nmsg, size_t size) {
-    uint8_t* pData = new uint8_t[size];               // Data buffer.
+static void
+sendFrom(nng_socket s, size_t nmsg, size_t size, SendBuffer& buffer) {
+    uint8_t* pData = buffer.data();
 
     for (int i = 0; i < nmsg; i++) {
         checkstat(
-            nng_send(s, reinterpret_cast<void*>(pData), size, 0),
+            tracedSend(s, reinterpret_cast<void*>(pData), size, 0),
             "Sender sending a message"
         );
     }
-    delete []pData;
+}
+
+/**
+ * timedReceiver
+ *    Receive nmsg messages on an existing socket and record when the
+ *  last one arrived.
+ *
+ * @param s         - socket to receive on.
+ * @param nmsg      - number of messages.
+ * @param pEnd[out] - time the last message was received.
+ */
+static void
+timedReceiver(
+    nng_socket s, size_t nmsg,
+    std::chrono::high_resolution_clock::time_point* pEnd
+) {
+    void*  pData;
+    size_t rcvSize;
+    for (int i = 0; i < nmsg; i++) {
+        checkstat(
+            perfRecv(s, &pData, &rcvSize),
+            "Receiver receiving a message"
+        );
+        nng_free(pData, rcvSize);
+    }
+    *pEnd = std::chrono::high_resolution_clock::now();
+}
+
+/**
+ * report
+ *   Output the timing for one direction (or the aggregate).
+ *
+ * @param title - what's being reported.
+ * @param duration - how long it took.
+ * @param nmsg  - messages transferred.
+ * @param bytes - bytes transferred.
+ */
+static void
+report(
+    const char* title, std::chrono::high_resolution_clock::duration duration,
+    size_t nmsg, size_t bytes
+) {
+    double timing = (double)std::chrono::duration_cast<std::chrono::milliseconds>(duration).count()/1000.0;
+    std::cout << title << std::endl;
+    std::cout << "Time:       " << timing << std::endl;
+    std::cout << "msgs/sec:   " << (double)nmsg/timing << std::endl;
+    std::cout << "KB/sec:     " << (double)bytes/timing/1024.0 << std::endl;
+}
+
+/**
+ * duplex
+ *    Run the full duplex measurement (see the top of the file).
+ *
+ * @param uri     - URI the listener end listens on.
+ * @param nmsg    - messages in each direction.
+ * @param msgSize - size of dialer -> listener messages.
+ * @param ackSize - size of listener -> dialer messages.
+ */
+static void
+duplex(const std::string& uri, size_t nmsg, size_t msgSize, size_t ackSize) {
+    nng_socket listener;
+    nng_socket dialer;
+    std::chrono::high_resolution_clock::time_point forwardEnd;
+    std::chrono::high_resolution_clock::time_point reverseEnd;
+
+    checkstat(
+        nng_pair0_open(&listener),
+        "Creating the listener socket."
+    );
+    checkstat(
+        perfListen(listener, uri.c_str(), nullptr, 0),
+        "Listening on socket."
+    );
+    checkstat(
+        nng_pair0_open(&dialer),
+        "Creating the dialer socket."
+    );
+    checkstat(
+        nng_dial(dialer, uri.c_str(), nullptr, 0),
+        "Dialing the listener"
+    );
+
+    std::cout << "Hit enter to start timing: ";
+    std::cout.flush();
+    std::cin.get();
+    std::cout << "Let's go\n";
+
+    SendBuffer forwardBuffer(msgSize);      // Not timed.
+    SendBuffer reverseBuffer(ackSize);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::thread forwardReceiver(timedReceiver, listener, nmsg, &forwardEnd);
+    std::thread reverseReceiver(timedReceiver, dialer, nmsg, &reverseEnd);
+    std::thread reverseSender(
+        sendFrom, listener, nmsg, ackSize, std::ref(reverseBuffer)
+    );
+    sendFrom(dialer, nmsg, msgSize, forwardBuffer);   // Forward direction in this thread.
+
+    reverseSender.join();
+    forwardReceiver.join();
+    reverseReceiver.join();
+    auto end = std::max(forwardEnd, reverseEnd);
+
+    report("Forward (dialer -> listener)", forwardEnd - start, nmsg, nmsg*msgSize);
+    report("Reverse (listener -> dialer)", reverseEnd - start, nmsg, nmsg*ackSize);
+    report("Aggregate", end - start, 2*nmsg, nmsg*(msgSize + ackSize));
+
+    nng_close(dialer);
+    nng_close(listener);
+}
+
+/**
+ * streams
+ *    Run nstreams pairs at once (see the top of the file).
+ *
+ * @param uri      - URI template with a %d for the stream number.
+ * @param nmsg     - messages in each stream.
+ * @param msgSize  - size of the messages.
+ * @param nstreams - number of streams.
+ */
+static void
+streams(const std::string& uri, size_t nmsg, size_t msgSize, size_t nstreams) {
+    auto uris = constructEndpoints(uri.c_str(), nstreams);
+    std::vector<nng_socket> listeners(nstreams);
+    std::vector<nng_socket> dialers(nstreams);
+    std::vector<std::chrono::high_resolution_clock::time_point> ends(nstreams);
+    std::vector<std::thread*> threads;
+    std::vector<SendBuffer*> buffers;
+
+    for (int i = 0; i < nstreams; i++) {
+        checkstat(
+            nng_pair0_open(&listeners[i]),
+            "Creating a listener socket."
+        );
+        checkstat(
+            perfListen(listeners[i], uris[i].c_str(), nullptr, 0),
+            "Listening on socket."
+        );
+        checkstat(
+            nng_pair0_open(&dialers[i]),
+            "Creating a dialer socket."
+        );
+        checkstat(
+            nng_dial(dialers[i], uris[i].c_str(), nullptr, 0),
+            "Dialing a listener"
+        );
+    }
+
+    std::cout << "Hit enter to start timing: ";
+    std::cout.flush();
+    std::cin.get();
+    std::cout << "Let's go\n";
+
+    for (int i = 0; i < nstreams; i++) {
+        buffers.push_back(new SendBuffer(msgSize));   // Not timed.
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < nstreams; i++) {
+        threads.push_back(new std::thread(timedReceiver, listeners[i], nmsg, &ends[i]));
+        threads.push_back(new std::thread(
+            sendFrom, dialers[i], nmsg, msgSize, std::ref(*buffers[i])
+        ));
+    }
+    for (auto p : threads) {
+        p->join();
+        delete p;
+    }
+
+    reportStreams(start, ends, nmsg, nmsg*msgSize);
+
+    for (auto p : buffers) {
+        delete p;
+    }
+    for (int i = 0; i < nstreams; i++) {
+        nng_close(dialers[i]);
+        nng_close(listeners[i]);
+    }
 }
 
 /**
@@ -133,6 +323,16 @@ int main(int argc, char** argv) {
     size_t msgSize = atol(argv[3]);
     char cr;
 
+    if (argc > 4 && std::string(argv[4]) == "duplex") {
+        size_t ackSize = (argc > 5) ? atol(argv[5]) : msgSize;
+        duplex(uri, nmsg, msgSize, ackSize);
+        return EXIT_SUCCESS;
+    }
+    if (argc > 5 && std::string(argv[4]) == "streams") {
+        streams(uri, nmsg, msgSize, atol(argv[5]));
+        return EXIT_SUCCESS;
+    }
+
     nng_socket s;
     // start the receiver:
 
@@ -160,8 +360,10 @@ int main(int argc, char** argv) {
     // start time:
 
     
+    SendBuffer buffer(msgSize);
+    TlbCounter tlb;
     auto start = std::chrono::high_resolution_clock::now();
-    sender(s, nmsg, msgSize);
+    sendFrom(s, nmsg, msgSize, buffer);
     thrReceiver.join();                  // Ensures the sender got them all.
     auto end = std::chrono::high_resolution_clock::now();
     auto duration = end - start;       // and std::duration.
@@ -178,6 +380,7 @@ int main(int argc, char** argv) {
     std::cout << "Time:       " << timing << std::endl;
     std::cout << "msgs/sec:   " << msgTiming << std::endl;
     std::cout << "KB/sec:     " << xferTiming/1024.0 << std::endl;
+    tlb.report(std::cout, buffer, nmsg);
 
     return EXIT_SUCCESS;
 
@@ -0,0 +1,276 @@
+/**
+ *  This program summarizes repeated benchmark runs and compares them
+ * with a stored baseline.  One run of a benchmark is one sample; run it
+ * several times with repeat.sh, which collects every "label: number" the
+ * program prints into a results file of lines:
+ *
+ *      metric<TAB>value
+ *
+ *   Usage:
+ *      perfstats summary results
+ *      perfstats compare baseline results [threshold%]
+ *
+ *   Where:
+ *     results   - a results file (repeat.sh).
+ *     baseline  - an earlier results file to compare against - e.g. a
+ *                 copy of one made before an nng or kernel upgrade.
+ *     threshold - changes in the median smaller than this percentage
+ *                 are never flagged (default 2).
+ *
+ *   Output:
+ *     summary - for each metric the number of samples, mean, standard
+ *               deviation, coefficient of variation, median with its 95%
+ *               bootstrap confidence interval, min, max and any outliers
+ *               (outside 1.5 interquartile ranges of the quartiles).
+ *     compare - for each metric in both files the two medians, the
+ *               change and a 95% bootstrap confidence interval for it.
+ *               A change is beyond noise when the interval excludes zero
+ *               and the change is at least the threshold.  Metrics with
+ *               "/sec" or "/s" in their name are better higher; all others
+ *               (times, latencies, CPU) are better lower.  Changes for the
+ *               worse are flagged REGRESSION and make the exit status 1 so
+ *               a script can fail on them.  A metric with fewer than 3
+ *               samples on either side is reported as insufficient
+ *               samples and never flagged.
+ */
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+
+#include "perfutil.h"
+
+static const int    RESAMPLES(10000);      // Bootstrap resamples.
+static const double CONFIDENCE(95.0);      // Percent.
+static const size_t MIN_SAMPLES(3);        // Fewer and a bootstrap says nothing.
+
+typedef std::map<std::string, std::vector<double>> Samples;
+
+/**
+ * readResults
+ *    Read a results file.  Metrics stay in the order first seen.
+ *
+ * @param filename - file to read.
+ * @param order    - metric names in file order.
+ * @return Samples - each metric's values.
+ */
+static Samples
+readResults(const char* filename, std::vector<std::string>& order) {
+    std::ifstream in(filename);
+    if (!in) {
+        std::cerr << "Unable to open " << filename << std::endl;
+        exit(2);
+    }
+    Samples result;
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t tab = line.rfind('\t');
+        if (tab == std::string::npos) continue;
+        std::string metric = line.substr(0, tab);
+        if (!result.count(metric)) order.push_back(metric);
+        result[metric].push_back(atof(line.c_str() + tab + 1));
+    }
+    return result;
+}
+
+static double
+median(std::vector<double> values) {
+    if (values.empty()) return 0.0;
+    std::sort(values.begin(), values.end());
+    size_t n = values.size();
+    return (n % 2) ? values[n/2] : (values[n/2 - 1] + values[n/2])/2.0;
+}
+
+static double
+mean(const std::vector<double>& values) {
+    double sum = 0;
+    for (auto v : values) sum += v;
+    return values.empty() ? 0.0 : sum/values.size();
+}
+
+static double
+stddev(const std::vector<double>& values) {
+    if (values.size() < 2) return 0.0;
+    double m = mean(values);
+    double sum = 0;
+    for (auto v : values) sum += (v - m)*(v - m);
+    return std::sqrt(sum/(values.size() - 1));
+}
+
+/**
+ * resample
+ *    A bootstrap resample: values.size() draws with replacement.
+ */
+static std::vector<double>
+resample(const std::vector<double>& values, std::mt19937_64& gen) {
+    std::uniform_int_distribution<size_t> pick(0, values.size() - 1);
+    std::vector<double> result(values.size());
+    for (auto& v : result) v = values[pick(gen)];
+    return result;
+}
+
+/**
+ * interval
+ *    The central CONFIDENCE percent of a bootstrap distribution.
+ */
+static void
+interval(std::vector<double>& estimates, double& low, double& high) {
+    std::sort(estimates.begin(), estimates.end());
+    low  = percentile(estimates, (100.0 - CONFIDENCE)/2.0, 1.0);
+    high = percentile(estimates, 100.0 - (100.0 - CONFIDENCE)/2.0, 1.0);
+}
+
+/**
+ * higherIsBetter
+ *    Rates are better higher, everything else lower.
+ */
+static bool
+higherIsBetter(const std::string& metric) {
+    return metric.find("/sec") != std::string::npos ||
+        metric.find("/s") == metric.size() - 2 ||
+        metric.find("/s#") != std::string::npos;
+}
+
+/**
+ * summary
+ *    Describe each metric of a results file.
+ */
+static int
+summary(const char* filename) {
+    std::vector<std::string> order;
+    Samples samples = readResults(filename, order);
+    std::mt19937_64 gen(1);
+
+    for (auto& metric : order) {
+        std::vector<double> values = samples[metric];
+        std::sort(values.begin(), values.end());
+        double m = mean(values), sd = stddev(values);
+
+        std::vector<double> medians;
+        for (int i = 0; i < RESAMPLES; i++) {
+            medians.push_back(median(resample(values, gen)));
+        }
+        double low, high;
+        interval(medians, low, high);
+
+        double q1 = percentile(values, 25.0, 1.0), q3 = percentile(values, 75.0, 1.0);
+        double fence = 1.5*(q3 - q1);
+        std::vector<double> outliers;
+        for (auto v : values) {
+            if (v < q1 - fence || v > q3 + fence) outliers.push_back(v);
+        }
+
+        std::cout << metric << std::endl;
+        std::cout << "   n " << values.size()
+                  << "  mean " << m << "  stddev " << sd
+                  << "  cv% " << std::setprecision(3) << (m != 0 ? 100.0*sd/std::fabs(m) : 0.0)
+                  << std::setprecision(6) << std::endl;
+        std::cout << "   median " << median(values) << "  " << CONFIDENCE << "% CI ";
+        if (values.size() >= MIN_SAMPLES) {
+            std::cout << "[" << low << ", " << high << "]";
+        } else {
+            std::cout << "- (insufficient samples)";
+        }
+        std::cout << "  min " << values.front() << "  max " << values.back() << std::endl;
+        if (!outliers.empty()) {
+            std::cout << "   outliers:";
+            for (auto v : outliers) std::cout << " " << v;
+            std::cout << std::endl;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * compare
+ *    Compare the medians of each metric in two results files.
+ * @return int - 1 if anything regressed.
+ */
+static int
+compare(const char* baselineFile, const char* resultsFile, double threshold) {
+    std::vector<std::string> baseOrder, order;
+    Samples baseline = readResults(baselineFile, baseOrder);
+    Samples results  = readResults(resultsFile, order);
+    std::mt19937_64 gen(1);
+    int regressions = 0;
+
+    std::cout << std::left << std::setw(40) << "metric" << std::right
+              << std::setw(14) << "baseline" << std::setw(14) << "now"
+              << std::setw(10) << "change%" << std::setw(22) << "95% CI"
+              << "  verdict" << std::endl;
+    for (auto& metric : order) {
+        if (!baseline.count(metric)) continue;
+        const std::vector<double>& before = baseline[metric];
+        const std::vector<double>& after  = results[metric];
+        double base = median(before), now = median(after);
+        if (base == 0) continue;
+        if (before.size() < MIN_SAMPLES || after.size() < MIN_SAMPLES) {
+            std::cout << std::left << std::setw(40) << metric << std::right
+                      << std::setw(14) << base << std::setw(14) << now
+                      << std::setw(10) << "-" << std::setw(22) << "-"
+                      << "  insufficient samples (need " << MIN_SAMPLES << " each)"
+                      << std::endl;
+            continue;
+        }
+
+        // Bootstrap the relative change of the medians.
+
+        std::vector<double> changes;
+        for (int i = 0; i < RESAMPLES; i++) {
+            double b = median(resample(before, gen));
+            double a = median(resample(after, gen));
+            if (b != 0) changes.push_back(100.0*(a - b)/std::fabs(b));
+        }
+        double low, high;
+        interval(changes, low, high);
+        double change = 100.0*(now - base)/std::fabs(base);
+
+        const char* verdict = "same";
+        bool beyondNoise = (low > 0 || high < 0) && std::fabs(change) >= threshold;
+        if (beyondNoise) {
+            bool better = higherIsBetter(metric) ? change > 0 : change < 0;
+            verdict = better ? "improved" : "REGRESSION";
+            if (!better) regressions++;
+        }
+        std::ostringstream ci;
+        ci << std::fixed << std::setprecision(1) << "[" << low << ", " << high << "]";
+        std::cout << std::left << std::setw(40) << metric << std::right
+                  << std::setw(14) << base << std::setw(14) << now
+                  << std::fixed << std::setprecision(1) << std::setw(10) << change
+                  << std::setw(22) << ci.str() << "  " << verdict << std::endl;
+        std::cout.unsetf(std::ios::fixed);
+        std::cout << std::setprecision(6);
+    }
+    for (auto& metric : baseOrder) {
+        if (!results.count(metric)) {
+            std::cout << metric << ": not in " << resultsFile << std::endl;
+        }
+    }
+    std::cout << regressions << " regression(s)" << std::endl;
+    return regressions ? 1 : EXIT_SUCCESS;
+}
+
+/**
+ *  Entry point
+ * @note - this is not production code so missing command line
+ * parameters most likely result in a segfault.
+ */
+int main(int argc, char** argv) {
+    std::string command(argv[1]);
+    if (command == "summary") {
+        return summary(argv[2]);
+    }
+    if (command == "compare") {
+        double threshold = (argc > 4) ? atof(argv[4]) : 2.0;
+        return compare(argv[2], argv[3], threshold);
+    }
+    std::cerr << "Usage: perfstats summary results | compare baseline results [threshold%]\n";
+    return 2;
+}
@@ -0,0 +1,150 @@
+/**
+ * Small helpers shared by the performance programs:
+ *
+ *   checkstat(status, doing) - exit with a message if an nng call failed.
+ *   checkerr(status, doing)  - the same for system calls (errno).
+ *   now()                    - CLOCK_MONOTONIC in nanoseconds.
+ *   percentile(sorted, p)    - a percentile of sorted samples, by default
+ *                              nanoseconds reported in microseconds.
+ *   threadCount()            - threads in this process.
+ *   rssKB()                  - current resident set size.
+ *   peakRssKB()              - peak resident set size.
+ *   cpuSeconds()             - user + system CPU used by this process.
+ */
+#ifndef PERFUTIL_H
+#define PERFUTIL_H
+
+#include <nng/nng.h>
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+/**
+ * checkstat
+ *    Check the status of an nng call and output a message/exit
+ * if the result is not ok.
+ *
+ * @param status - nng status returned from a call.
+ * @param doing  - text that will describe what failed.
+ */
+static inline void
+checkstat(int status,  const char* doing) {
+    if (status) {
+        std::cerr << doing << ": " << nng_strerror(status) << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * checkerr
+ *    Check the result of a system call and output a message/exit
+ * if it failed.
+ *
+ * @param status - return value of the call (< 0 is failure).
+ * @param doing  - text that will describe what failed.
+ */
+static inline void
+checkerr(long status, const char* doing) {
+    if (status < 0) {
+        std::cerr << doing << ": " << strerror(errno) << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * now
+ *   @return uint64_t - CLOCK_MONOTONIC in nanoseconds.
+ */
+static inline uint64_t
+now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+/**
+ * percentileIndex
+ *   @param n - number of samples (> 0).
+ *   @param p - percentile wanted [0, 100].
+ *   @return size_t - index of that percentile in the sorted samples.
+ */
+static inline size_t
+percentileIndex(size_t n, double p) {
+    return static_cast<size_t>((p/100.0) * (n - 1) + 0.5);
+}
+
+/**
+ * percentile
+ *   @param sorted - sorted samples.
+ *   @param p      - percentile wanted [0, 100].
+ *   @param scale  - the result is divided by this (default ns -> us).
+ *   @return double - the percentile (0 if there are no samples).
+ */
+template <typename T>
+static inline double
+percentile(const std::vector<T>& sorted, double p, double scale = 1000.0) {
+    if (sorted.empty()) return 0.0;
+    return sorted[percentileIndex(sorted.size(), p)]/scale;
+}
+
+/**
+ * threadCount
+ *   @return int - number of threads in this process (from /proc).
+ */
+static inline int
+threadCount() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 8, "Threads:") == 0) {
+            return atoi(line.c_str() + 8);
+        }
+    }
+    return 0;
+}
+
+/**
+ * rssKB
+ *   @return long - current resident set size in KB (from /proc).
+ */
+static inline long
+rssKB() {
+    std::ifstream statm("/proc/self/statm");
+    long size = 0, resident = 0;
+    statm >> size >> resident;
+    return resident * (sysconf(_SC_PAGESIZE)/1024);
+}
+
+/**
+ * peakRssKB
+ *   @return long - peak resident set size of this process in KB.
+ */
+static inline long
+peakRssKB() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/**
+ * cpuSeconds
+ *   @return double - user + system CPU seconds used by this process.
+ */
+static inline double
+cpuSeconds() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec/1.0e6 +
+        usage.ru_stime.tv_sec + usage.ru_stime.tv_usec/1.0e6;
+}
+
+#endif
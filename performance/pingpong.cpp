@@ -0,0 +1,157 @@
+// Measure round trip latency on a pair socket, the way onetoones and
+// onetoonec talk: the client sends a message and the server echoes it.
+//  Usage:
+//    pingpong uri niter msgsize [nwarmup]
+//
+//      uri     - the URI the echo server listens on and the client dials.
+//      niter   - number of timed round trips.
+//      msgsize - size in bytes of the message bounced back and forth.
+//      nwarmup - untimed round trips done first (default 1000) so
+//                connection setup, page faults and cold caches are out of
+//                the way before we measure.
+//
+//  An echo thread listens on the URI and, like onetoones, sends each
+//  message it receives straight back as the same nng_msg, so the echo
+//  adds no copy of the body.  The main thread dials and does the round
+//  trips one at a time, timing each with the monotonic clock
+//  (nanosecond resolution; the resolution the kernel reports is output).
+//
+//  Output is min, median, p99, p99.9 and max round trip time in
+//  microseconds and the CPU used per round trip.  pingpong.sh runs it
+//  across transports and sizes; recvmode.sh compares blocking receives
+//  with the busy poll and SCHED_FIFO modes of recvmode.h, which both the
+//  echo thread and the client use.
+//
+
+#include <thread>
+#include <nng/nng.h>
+#include <nng/protocol/pair0/pair.h>
+
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "recvmode.h"
+#include "netns.h"
+#include "perfutil.h"
+
+
+/**
+ * echo
+ *    The echo thread: listen, then echo nmsg messages back.
+ *
+ * @param s    - socket to listen with (already open).
+ * @param nmsg - number of messages to echo.
+ */
+static void
+echo(nng_socket s, size_t nmsg) {
+    perfReceiverSetup();
+    for (int i = 0; i < nmsg; i++) {
+        nng_msg* pMsg;
+        checkstat(
+            perfRecvMsg(s, &pMsg),
+            "Echo failed to get a message"
+        );
+        TraceScope trace("send", traceNextSend());
+        checkstat(
+            nng_sendmsg(s, pMsg, 0),                 // takes ownership of pMsg.
+            "Echo failed to send a message back"
+        );
+    }
+}
+
+/**
+ * roundTrip
+ *    Send a message and wait for it to come back.
+ *
+ * @param s     - dialed socket.
+ * @param pData - message data.
+ * @param size  - message size.
+ */
+static void
+roundTrip(nng_socket s, void* pData, size_t size) {
+    void*  pReply;
+    size_t replySize;
+    checkstat(
+        tracedSend(s, pData, size, 0),
+        "Failed to send ping"
+    );
+    checkstat(
+        perfRecv(s, &pReply, &replySize),
+        "Failed to get pong"
+    );
+    nng_free(pReply, replySize);
+}
+
+/**
+ *  entry point.
+ * @note test quality code so we don't check argc.
+ */
+int main(int argc, char** argv) {
+    std::string uri(argv[1]);
+    size_t niter = atol(argv[2]);
+    size_t msgSize = atol(argv[3]);
+    size_t nwarmup = (argc > 4) ? atol(argv[4]) : 1000;
+    nng_socket server;
+    nng_socket client;
+
+    checkstat(
+        nng_pair0_open(&server),
+        "Failed to open the echo socket"
+    );
+    checkstat(
+        perfListen(server, uri.c_str(), nullptr, 0),
+        "Echo failed to listen"
+    );
+    std::thread echoer(echo, server, nwarmup + niter);
+
+    checkstat(
+        nng_pair0_open(&client),
+        "Failed to open the client socket"
+    );
+    checkstat(
+        nng_dial(client, uri.c_str(), nullptr, 0),
+        "Client failed to dial the echo server"
+    );
+
+    perfReceiverSetup();
+    uint8_t* pData = new uint8_t[msgSize];
+    std::vector<uint64_t> rtts;
+    rtts.reserve(niter);
+
+    for (int i = 0; i < nwarmup; i++) {
+        roundTrip(client, pData, msgSize);
+    }
+    double cpuStart = cpuSeconds();
+    uint64_t wallStart = now();
+    for (int i = 0; i < niter; i++) {
+        uint64_t start = now();
+        roundTrip(client, pData, msgSize);
+        rtts.push_back(now() - start);
+    }
+    double wall = (now() - wallStart)/1.0e9;
+    double cpu  = cpuSeconds() - cpuStart;
+    echoer.join();
+    delete []pData;
+    nng_close(client);
+    nng_close(server);
+
+    std::sort(rtts.begin(), rtts.end());
+    struct timespec res;
+    clock_getres(CLOCK_MONOTONIC, &res);
+
+    std::cout << "Clock resolution (ns): " << res.tv_nsec << std::endl;
+    std::cout << "RTT (us) min:    " << (rtts.empty() ? 0.0 : rtts.front()/1000.0) << std::endl;
+    std::cout << "RTT (us) median: " << percentile(rtts, 50.0) << std::endl;
+    std::cout << "RTT (us) p99:    " << percentile(rtts, 99.0) << std::endl;
+    std::cout << "RTT (us) p99.9:  " << percentile(rtts, 99.9) << std::endl;
+    std::cout << "RTT (us) max:    " << (rtts.empty() ? 0.0 : rtts.back()/1000.0) << std::endl;
+    std::cout << "CPU us/RTT:      " << 1.0e6*cpu/niter << std::endl;
+    std::cout << "CPU/wall:        " << cpu/wall << std::endl;
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,16 @@
+#!/bin/bash
+
+# Round trip latency across transports and message sizes:
+
+echo Ping pong log > pingpong.log
+
+for service in tcp://localhost:3000 ipc:///tmp/pingpong inproc://pingpong
+do
+    echo ----    $service latency -------- >> pingpong.log
+
+    for size in 16 256 1024 4096 16384 65536 262144 1048576
+    do
+	echo msg size $size >> pingpong.log
+	./pingpong $service 100000 $size 1000 >> pingpong.log
+    done
+done
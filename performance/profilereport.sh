@@ -0,0 +1,59 @@
+#!/bin/bash
+
+# Compare sweep logs written by profiles.sh:
+#    profilereport.sh debug.log release.log ...
+# One row per run (pattern and message size) and figure: the first
+# msgs/sec (Surveys/sec) it printed, and for pingpong the median RTT and
+# the CPU per round trip.  One column per log, in the order given, then
+#   best    - the profile with the lowest cost (time per message).
+#   saved%  - how much of the first log's cost per message that profile
+#             removed.  With the debug log first that's the share of the
+#             debug build's measured cost that was our unoptimized client
+#             code rather than nng and the kernel.
+
+awk '
+function set(row, value, higherBetter) {
+    if (!(row in known)) {
+        known[row] = 1
+        order[++nrows] = row
+        better[row] = higherBetter
+    }
+    values[row, nfiles] = value + 0
+}
+function cost(row, i) {
+    v = values[row, i]
+    if (v <= 0) return 0
+    return better[row] ? 1.0/v : v
+}
+FNR == 1          { name[++nfiles] = $1; next }         # "<profile> build"
+/^---- /          { run = $2 " " $3; haveRate = 0; next }
+/msgs\/sec|Surveys\/sec/ && !haveRate {
+    split($0, f, ":"); set(run " msgs/sec", f[2], 1); haveRate = 1
+}
+/^RTT \(us\) median/ { split($0, f, ":"); set(run " RTT p50 us", f[2], 0) }
+/^CPU us\/RTT/       { split($0, f, ":"); set(run " CPU us/RTT", f[2], 0) }
+END {
+    printf "%-30s", "run"
+    for (i = 1; i <= nfiles; i++) printf " %12s", name[i]
+    printf " %8s %7s\n", "best", "saved%"
+    for (r = 1; r <= nrows; r++) {
+        row = order[r]
+        printf "%-30s", row
+        best = 0
+        for (i = 1; i <= nfiles; i++) {
+            if ((row, i) in values) {
+                printf " %12.1f", values[row, i]
+                c = cost(row, i)
+                if (c > 0 && (best == 0 || c < cost(row, best))) best = i
+            } else {
+                printf " %12s", "-"
+            }
+        }
+        if (best && cost(row, 1) > 0) {
+            printf " %8s %7.1f\n", name[best], 100.0*(1.0 - cost(row, best)/cost(row, 1))
+        } else {
+            printf " %8s %7s\n", "-", "-"
+        }
+    }
+}
+' "$@"
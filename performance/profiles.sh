@@ -0,0 +1,68 @@
+#!/bin/bash
+
+# Build the benchmarks in each build profile (see the Makefile), run the
+# same sweep with each build and compare them.  The pgo build is trained
+# by running the sweep, with fewer messages, on a pgo-gen build.  The
+# numbers that don't move between debug and the optimized builds are nng
+# and the kernel; what does move is our client code.
+#
+# Writes profiles/<profile>.log and the comparison to
+# profiles/report.txt (profilereport.sh).
+
+NMSG=${NMSG:-100000}
+TRAIN_NMSG=${TRAIN_NMSG:-20000}
+
+# sweep log nmsg
+
+sweep() {
+    log=$1
+    n=$2
+    for size in 100 1024 65536
+    do
+	echo ---- pair $size ---- >> $log
+	echo | ./pair tcp://localhost:3000 $n $size >> $log
+	echo ---- pushpull $size ---- >> $log
+	echo | ./pushpull tcp://localhost:3001 $n $size 4 >> $log
+	echo ---- pubsub $size ---- >> $log
+	echo | ./pubsub tcp://localhost:3002 $n $size 4 >> $log
+	echo ---- reqrep $size ---- >> $log
+	./reqrep tcp://localhost:3003 $n $size >> $log
+	echo ---- survey $size ---- >> $log
+	./survey tcp://localhost:3004 $((n / 10)) $size 4 >> $log
+	echo ---- bus $size ---- >> $log
+	./bus tcp://localhost:301%d $n $size 4 >> $log
+	echo ---- pingpong $size ---- >> $log
+	./pingpong tcp://localhost:3005 $n $size 1000 >> $log
+    done
+}
+
+mkdir -p profiles
+
+for profile in debug release lto
+do
+    make clean > /dev/null
+    make PROFILE=$profile > /dev/null || exit 1
+    echo $profile build > profiles/$profile.log
+    sweep profiles/$profile.log $NMSG
+done
+
+# Profile guided: train, then build with the profile.
+
+make clean > /dev/null
+make cleanpgo > /dev/null
+make PROFILE=pgo-gen > /dev/null || exit 1
+sweep /dev/null $TRAIN_NMSG
+
+make clean > /dev/null
+make PROFILE=pgo > /dev/null || exit 1
+echo pgo build > profiles/pgo.log
+sweep profiles/pgo.log $NMSG
+
+# Leave the default build behind.
+
+make clean > /dev/null
+make > /dev/null
+
+./profilereport.sh profiles/debug.log profiles/release.log profiles/lto.log profiles/pgo.log \
+    > profiles/report.txt
+cat profiles/report.txt
@@ -39,23 +39,11 @@
 #include <unistd.h>
 #include <vector>
 
-
-/**
- * checkstat
- *    Check the status of an nng call and output a message/exit
- * if the result is not ok.
- * 
- * @param status - nng status returned from a call.
- * @param doing  - text that will describe what failed.
- * 
- */
-static void 
-checkstat(int status,  const char* doing) {
-    if (status) {
-        std::cerr << doing << ": " << nng_strerror(status) << std::endl;
-        exit(EXIT_FAILURE);
-    }
-}
+#include "recvmode.h"
+#include "netns.h"
+#include "sendbuffer.h"
+#include "backpressure.h"
+#include "perfutil.h"
 
 
 /**
@@ -76,6 +64,7 @@ subscriber(std::string uri) {
     void*     pmsg;
     size_t    rcvSize;
     bool      done(false);
+    perfReceiverSetup();
 
     // set up the subscription:
 
@@ -96,7 +85,7 @@ subscriber(std::string uri) {
 
     while(! done) {
         checkstat(
-            nng_recv(s, &pmsg, &rcvSize, NNG_FLAG_ALLOC),
+            perfRecv(s, &pmsg, &rcvSize),
             "Failed to receive subscription msg"
         );
         
@@ -119,16 +108,22 @@ subscriber(std::string uri) {
  *   @param s[in] - socket setup to publish
  *   @param nmsg[in] - number of messages to publish.
  *   @param size[in] - bytes in each msg.
+ *   @param profile  - sends go through this so PERF_BACKPRESSURE can
+ *                     profile them (see backpressure.h).
+ *   @param buffer   - size bytes to publish from (see sendbuffer.h).
  * 
  * @note the first byte of all but he last message is 0.
- * @note we allocate the message block only once.
+ * @note we use the one message block for every message.
  */
 void
-publisher(nng_socket s, size_t nmsg, size_t size) {
+publisher(
+    nng_socket s, size_t nmsg, size_t size, BackpressureProfile& profile,
+    SendBuffer& buffer
+) {
     // The messgae block:
 
     
-    uint8_t* pMessage = new uint8_t[size];
+    uint8_t* pMessage = buffer.data();
     pMessage[0] = 0;                            // not the last.
 
     // Send all but the last msg.
@@ -136,7 +131,7 @@ publisher(nng_socket s, size_t nmsg, size_t size) {
     for (int i =0; i < nmsg-1; i++) {
         
         checkstat(
-            nng_send(s, pMessage, size, 0), 
+            profile.send(pMessage, size),
             "Publisher, publishing a message"
         );
     }
@@ -147,12 +142,9 @@ publisher(nng_socket s, size_t nmsg, size_t size) {
     pMessage[0] = 1;
     
     checkstat(
-        nng_send(s, pMessage, size, 0),
+        profile.send(pMessage, size),
         "Publishing last message"
     );
-    // Delete the storage
-
-    delete []pMessage;
 }
 
 
@@ -180,7 +172,7 @@ int main(int arg, char** argv) {
         "Publisher could not open socket"
     );
     checkstat(
-        nng_listen(s, uri.c_str(), nullptr, 0),
+        perfListen(s, uri.c_str(), nullptr, 0),
         "Publisher could not start listening"
     );
 
@@ -200,8 +192,11 @@ int main(int arg, char** argv) {
     cr = std::cin.get();
     std::cout << "Let's go\n";
 
+    BackpressureProfile profile(s, true);
+    SendBuffer buffer(msgSize);
+    TlbCounter tlb;
     auto start = std::chrono::high_resolution_clock::now();
-    publisher(s, nmsg, msgSize);   // publish
+    publisher(s, nmsg, msgSize, profile, buffer);   // publish
     
     // join the subscribers
 
@@ -225,6 +220,8 @@ int main(int arg, char** argv) {
     std::cout << "Time:       " << timing << std::endl;
     std::cout << "msgs/sec:   " << msgTiming << std::endl;
     std::cout << "KB/sec:     " << xferTiming/1024.0 << std::endl;
+    profile.report(std::cout);
+    tlb.report(std::cout, buffer, nmsg);
 
     // free the thread resources just in case:
 
@@ -0,0 +1,269 @@
+/**
+ *  This program measures how well push/pull load levels when the
+ * pullers are not all equally fast.
+ *   Usage:
+ *      pushload URI nmsgs size npullers nslow fastus slowus [dist]
+ *
+ *   Where:
+ *     URI      - is the URI used to communicate.
+ *     nmsgs    - is the number of messages that will be sent.
+ *     size     - is the size of each message in bytes (at least 16).
+ *     npullers - is the number of pullers that will be spun off.
+ *     nslow    - is how many of those pullers are slow (the first nslow).
+ *     fastus   - microseconds of synthetic work a fast puller does per message.
+ *     slowus   - microseconds of synthetic work a slow puller does per message.
+ *     dist     - fixed (default) - every message costs exactly the work above.
+ *                exp   - the work per message is exponentially distributed
+ *                        with the values above as the mean.
+ *
+ *   The synthetic work is a busy spin so it behaves like a CPU bound
+ *   reconstruction step rather than a sleep the scheduler can hide.
+ *
+ *   Each message carries, after the first 8 bytes, the steady clock time
+ *   (ns) at which it was handed to nng_send.  Pullers compute the end to
+ *   end latency as the time at which they finished processing the message
+ *   less that timestamp so queueing behind a slow sibling shows up.
+ *
+ *   Unlike pushpull we don't rely on end messages (which nng may batch into
+ *   the same puller).  Instead the pullers count the messages they get
+ *   into a shared counter.  The main thread waits for that counter to reach
+ *   nmsgs, stops the timing and then tells the pullers to exit. The pullers
+ *   have a receive timeout so they notice that even if no more data
+ *   arrives.
+ *
+ *   Output:
+ *     - Total time, msgs/sec, KB/sec as for pushpull.
+ *     - For each puller its speed class, message count, share of the total
+ *       and mean latency.
+ *     - End to end latency percentiles over all messages.
+ */
+#include <thread>
+#include <nng/nng.h>
+#include <nng/protocol/pipeline0/push.h>
+#include <nng/protocol/pipeline0/pull.h>
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <atomic>
+#include <random>
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#include "recvmode.h"
+#include "netns.h"
+#include "perfutil.h"
+
+
+/**
+ * spin
+ *    Burn CPU for the requested number of nanoseconds.
+ * @param ns - how long to spin.
+ */
+static void
+spin(uint64_t ns) {
+    uint64_t end = now() + ns;
+    while (now() < end)
+        ;
+}
+
+/**
+ *  Per puller results.  Each puller owns one of these so
+ *  there's no sharing until the join.
+ */
+struct PullerStats {
+    bool                  slow;
+    size_t                count;
+    std::vector<uint64_t> latencies;      // ns.
+};
+
+static std::atomic<size_t> received(0);   // Total data messages pulled.
+static std::atomic<bool>   finished(false); // Main says we can exit.
+
+/**
+ * puller
+ *    Dial the pusher and process messages until the main thread
+ *  says we're done.
+ *
+ * @param uri[in]   - The URI the pusher is listening on.
+ * @param workus    - Mean microseconds of work per message.
+ * @param exponential - If true the work is exponentially distributed.
+ * @param seed      - Random number seed for the work distribution.
+ * @param pStats[out] - Where our statistics go.
+ */
+static void
+puller(std::string uri, unsigned workus, bool exponential, unsigned seed, PullerStats* pStats) {
+    nng_socket s;
+    void*      pMsg;
+    size_t     rcvsize;
+    std::mt19937_64 gen(seed);
+    std::exponential_distribution<double> dist(workus ? 1.0/workus : 1.0);
+    perfReceiverSetup();
+
+    checkstat(
+        nng_pull0_open(&s),
+        "Unable to open a pull socket."
+    );
+    checkstat(
+        nng_setopt_ms(s, NNG_OPT_RECVTIMEO, 100),
+        "Unable to set puller receive timeout"
+    );
+    checkstat(
+        nng_dial(s, uri.c_str(), nullptr, 0),
+        "Puller dial failed"
+    );
+    while (true) {
+        int status = perfRecv(s, &pMsg, &rcvsize);
+        if (status == NNG_ETIMEDOUT) {
+            if (finished) break;
+            continue;
+        }
+        checkstat(status, "Pull of data failed.");
+
+        uint64_t sent;
+        memcpy(&sent, reinterpret_cast<uint8_t*>(pMsg) + sizeof(uint64_t), sizeof(sent));
+        nng_free(pMsg, rcvsize);
+
+        // Do the 'work':
+
+        TraceScope trace("process");
+        double us = exponential ? dist(gen) : workus;
+        spin(static_cast<uint64_t>(us * 1000.0));
+
+        pStats->latencies.push_back(now() - sent);
+        pStats->count++;
+        received++;
+    }
+    nng_close(s);
+}
+
+/**
+ *  pusher
+ *     Push the messages to the pullers.  Each message is timestamped
+ *  just before the send.
+ *
+ * @param s - socket on which to push  - must be listening.
+ * @param nmsg - Number of messages.
+ * @param msgSize - size of the messages
+ */
+static void
+pusher(nng_socket s, size_t nmsg, size_t msgSize) {
+    uint8_t* pMessage = new uint8_t[msgSize];
+    memset(pMessage, 0, msgSize);
+
+    for (int i = 0; i < nmsg; i++) {
+        uint64_t stamp = now();
+        memcpy(pMessage + sizeof(uint64_t), &stamp, sizeof(stamp));
+        checkstat(
+            tracedSend(s, pMessage, msgSize, 0),
+            "Failed to push a messages"
+        );
+    }
+    delete []pMessage;
+}
+
+/**
+ *  Entry point:
+ *     - Set up the push listen.
+ *     - Spin off the pullers, the first nslow of them slow.
+ *     - Time the push and the drain.
+ *     - report.
+ *
+ * @note
+ *    This is not production code so segfaults will likely happen
+ * if paramteers are missing.  See Usage at the start of the file.
+ */
+int main(int argc, char** argv) {
+    std::string uri(argv[1]);
+    const size_t nmsg(atoi(argv[2]));
+    size_t msgSize(atoi(argv[3]));
+    const size_t npullers(atoi(argv[4]));
+    const size_t nslow(atoi(argv[5]));
+    const unsigned fastus(atoi(argv[6]));
+    const unsigned slowus(atoi(argv[7]));
+    bool exponential = (argc > 8) && (std::string(argv[8]) == "exp");
+    nng_socket s;
+    std::vector<std::thread*> pullers;
+    std::vector<PullerStats>  stats(npullers);
+
+    if (msgSize < 2*sizeof(uint64_t)) {
+        msgSize = 2*sizeof(uint64_t);        // Room for the timestamp.
+    }
+
+    checkstat(
+        nng_push0_open(&s),
+        "Unable to create push socket."
+    );
+    checkstat(
+        perfListen(s, uri.c_str(), nullptr, 0),
+        "Unable to start pusher listening."
+    );
+
+    for (int i = 0; i < npullers; i++) {
+        stats[i].slow  = i < nslow;
+        stats[i].count = 0;
+        stats[i].latencies.reserve(nmsg);
+        pullers.push_back(new std::thread(
+            puller, uri, stats[i].slow ? slowus : fastus, exponential, i+1, &stats[i]
+        ));
+    }
+    std::cout << "Enter to start timing:";
+    std::cout.flush();
+    std::cin.get();
+    std::cout <<  "Lets go\n";
+
+    auto start = std::chrono::high_resolution_clock::now();
+    pusher(s, nmsg, msgSize);
+    while (received < nmsg) {
+        usleep(100);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    finished = true;
+    for (auto p : pullers) {
+        p->join();
+        delete p;
+    }
+    pullers.clear();
+    nng_close(s);
+
+    // Totals:
+
+    auto duration  = end - start;
+    double timing = (double)std::chrono::duration_cast<std::chrono::milliseconds>(duration).count()/1000.0;
+    double msgTiming = (double)nmsg/timing;
+    double xferTiming = (double)(nmsg * msgSize)/timing;
+
+    std::cout << "Time:       " << timing << std::endl;
+    std::cout << "msgs/sec:   " << msgTiming << std::endl;
+    std::cout << "KB/sec:     " << xferTiming/1024.0 << std::endl;
+
+    // Per puller share and the merged latencies:
+
+    std::vector<uint64_t> all;
+    all.reserve(nmsg);
+    std::cout << "Puller  class  msgs        share%   mean-lat(us)\n";
+    for (int i = 0; i < npullers; i++) {
+        double sum = 0;
+        for (auto l : stats[i].latencies) sum += l;
+        double mean = stats[i].count ? sum/stats[i].count/1000.0 : 0.0;
+        std::cout << std::setw(6) << i << "  "
+                  << (stats[i].slow ? "slow " : "fast ") << "  "
+                  << std::setw(10) << stats[i].count << "  "
+                  << std::setw(7) << std::fixed << std::setprecision(2)
+                  << 100.0*stats[i].count/nmsg << "  "
+                  << std::setw(12) << mean << std::endl;
+        all.insert(all.end(), stats[i].latencies.begin(), stats[i].latencies.end());
+    }
+    std::sort(all.begin(), all.end());
+    std::cout << "Latency (us) p50:   " << percentile(all, 50.0) << std::endl;
+    std::cout << "Latency (us) p90:   " << percentile(all, 90.0) << std::endl;
+    std::cout << "Latency (us) p99:   " << percentile(all, 99.0) << std::endl;
+    std::cout << "Latency (us) p99.9: " << percentile(all, 99.9) << std::endl;
+    std::cout << "Latency (us) max:   " << (all.empty() ? 0.0 : all.back()/1000.0) << std::endl;
+
+    return EXIT_SUCCESS;
+}
@@ -1,13 +1,18 @@
 /**
  *  This program performs timings of the push/pull pattern.
  *   Usage:
- *      pushpull URI nmsgs size npullers
+ *      pushpull URI nmsgs size npullers [streams nstreams]
  * 
  *   Where:
  *     URI - is the URI used to communicate.
  *     nmsgs - is the number of messages that will be sent.
  *     size  - is the size of each message in bytes.
  *     npullers - is the number of pullers that will be spun off.
+ *     streams - if present, nstreams pushers, each with npullers
+ *               pullers, run at once.  URI has a %d for the stream
+ *               number.  Each stream is timed from the common start to
+ *               its last puller joining and per stream and aggregate
+ *               rates are reported (see streams.h).
  * 
  *   Completing this is a bit tricky as messages are distributed
  *   to the pullers 'fairely' whatever that means (round robin is mentioned).
@@ -53,23 +58,13 @@
 #include <unistd.h>
 #include <vector>
 
+#include "recvmode.h"
+#include "netns.h"
+#include "sendbuffer.h"
+#include "backpressure.h"
+#include "streams.h"
+#include "perfutil.h"
 
-/**
- * checkstat
- *    Check the status of an nng call and output a message/exit
- * if the result is not ok.
- * 
- * @param status - nng status returned from a call.
- * @param doing  - text that will describe what failed.
- * 
- */
-static void 
-checkstat(int status,  const char* doing) {
-    if (status) {
-        std::cerr << doing << ": " << nng_strerror(status) << std::endl;
-        exit(EXIT_FAILURE);
-    }
-}
 
 /**
  * puller
@@ -87,6 +82,7 @@ puller(std::string uri) {
     nng_socket s;
     void*      pMsg;
     size_t     rcvsize;
+    perfReceiverSetup();
 
     // Dial up the pusher:
 
@@ -101,7 +97,7 @@ puller(std::string uri) {
     bool done = false;
     while (!done) {
         checkstat(
-            nng_recv(s, &pMsg, &rcvsize, NNG_FLAG_ALLOC),
+            perfRecv(s, &pMsg, &rcvsize),
             "Pull of data failed.,"
         );
         
@@ -124,12 +120,18 @@ puller(std::string uri) {
  * @param nmsg - Number of messages.
  * @param msgSize - size of the messages
  * @param npullers - number of pullers used to determine how to stop.
+ * @param profile - sends go through this so PERF_BACKPRESSURE can
+ *                  profile them (see backpressure.h).
+ * @param buffer  - msgSize bytes to send from (see sendbuffer.h).
  * 
  * @note An uncaught error is for nmsg < npullers.
  */
 static void
-pusher(nng_socket s, size_t nmsg, size_t msgSize, size_t npullers) {
-    uint8_t* pMessage = new uint8_t[msgSize];
+pusher(
+    nng_socket s, size_t nmsg, size_t msgSize, size_t npullers,
+    BackpressureProfile& profile, SendBuffer& buffer
+) {
+    uint8_t* pMessage = buffer.data();
     pMessage[0] = 0;                     // Keep going.
 
     // Send the messages with the continue:
@@ -137,7 +139,7 @@ pusher(nng_socket s, size_t nmsg, size_t msgSize, size_t npullers) {
     
     for (int i = 0; i < nmsg; i++) {
         checkstat(
-            nng_send(s, pMessage, msgSize, 0),
+            profile.send(pMessage, msgSize),
             "Failed to push a messages"
         );
     }
@@ -150,15 +152,105 @@ pusher(nng_socket s, size_t nmsg, size_t msgSize, size_t npullers) {
 
     for (int i =0; i < npullers; i++)  {
         checkstat(
-            nng_send(s, pMessage, msgSize, 0),
+            profile.send(pMessage, msgSize),
             "Failed to push end message"
         );
     }
+}
+/**
+ * stream
+ *    One of the streams: push the messages then join this stream's
+ *  pullers.
+ *
+ * @param pBuffer   - the stream's send buffer (made before timing starts).
+ * @param pullers   - the stream's puller threads.
+ * @param pEnd[out] - when the last puller joined.
+ */
+static void
+stream(
+    nng_socket s, size_t nmsg, size_t msgSize,
+    BackpressureProfile* pProfile, SendBuffer* pBuffer,
+    std::vector<std::thread*>* pullers,
+    std::chrono::high_resolution_clock::time_point* pEnd
+) {
+    pusher(s, nmsg, msgSize, pullers->size(), *pProfile, *pBuffer);
+    for (auto p : *pullers) {
+        p->join();
+    }
+    *pEnd = std::chrono::high_resolution_clock::now();
+}
 
+/**
+ * streams
+ *    Run nstreams push/pull streams at once (see the top of the file).
+ *
+ * @param uri      - URI template with a %d for the stream number.
+ * @param nstreams - number of streams.
+ */
+static void
+streams(
+    const std::string& uri, size_t nmsg, size_t msgSize, size_t npullers,
+    size_t nstreams
+) {
+    auto uris = constructEndpoints(uri.c_str(), nstreams);
+    std::vector<nng_socket> sockets(nstreams);
+    std::vector<std::vector<std::thread*>> pullers(nstreams);
+    std::vector<BackpressureProfile*> profiles;
+    std::vector<SendBuffer*> buffers;
+    std::vector<std::thread*> pushers;
+    std::vector<std::chrono::high_resolution_clock::time_point> ends(nstreams);
 
-    delete []pMessage;
+    for (int i = 0; i < nstreams; i++) {
+        checkstat(
+            nng_push0_open(&sockets[i]),
+            "Unable to create push socket."
+        );
+        checkstat(
+            perfListen(sockets[i], uris[i].c_str(), nullptr, 0),
+            "Unable to start pusher listening."
+        );
+        for (int j = 0; j < npullers; j++) {
+            pullers[i].push_back(new std::thread(puller, uris[i]));
+        }
+    }
+    std::cout << "Enter to start timing:";
+    std::cout.flush();
+    std::cin.get();
+    std::cout <<  "Lets go\n";
+
+    for (int i = 0; i < nstreams; i++) {
+        profiles.push_back(new BackpressureProfile(sockets[i]));
+        buffers.push_back(new SendBuffer(msgSize));
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < nstreams; i++) {
+        pushers.push_back(new std::thread(
+            stream, sockets[i], nmsg, msgSize, profiles[i], buffers[i],
+            &pullers[i], &ends[i]
+        ));
+    }
+    for (auto p : pushers) {
+        p->join();
+        delete p;
+    }
 
+    reportStreams(start, ends, nmsg, nmsg*msgSize);
+    for (auto p : profiles) {           // In stream order.
+        p->report(std::cout);
+        delete p;
+    }
+    for (auto p : buffers) {
+        delete p;
+    }
+
+    for (int i = 0; i < nstreams; i++) {
+        for (auto p : pullers[i]) {
+            delete p;
+        }
+        nng_close(sockets[i]);
+    }
 }
+
 /**
  *  Entry point:
  *     - Set up the push listen.
@@ -184,6 +276,11 @@ int main(int argc, char** argv) {
     nng_socket s;
     std::vector<std::thread*> pullers;
 
+    if (argc > 6 && std::string(argv[5]) == "streams") {
+        streams(uri, nmsg, msgSize, npullers, atol(argv[6]));
+        return EXIT_SUCCESS;
+    }
+
     /* Set up the listen: */
 
     checkstat(
@@ -191,7 +288,7 @@ int main(int argc, char** argv) {
         "Unable to create push socket."
     );
     checkstat(
-        nng_listen(s, uri.c_str(), nullptr, 0),
+        perfListen(s, uri.c_str(), nullptr, 0),
         "Unable to start pusher listening."
     );
     // Create the theards and wait for them to start:
@@ -206,8 +303,11 @@ int main(int argc, char** argv) {
 
     // By now everything shoulid be going.
 
+    BackpressureProfile profile(s);
+    SendBuffer buffer(msgSize);
+    TlbCounter tlb;
     auto start = std::chrono::high_resolution_clock::now();
-    pusher(s, nmsg, msgSize, npullers);
+    pusher(s, nmsg, msgSize, npullers, profile, buffer);
 
     // include the joins in the timings:
 
@@ -227,6 +327,8 @@ int main(int argc, char** argv) {
     std::cout << "Time:       " << timing << std::endl;
     std::cout << "msgs/sec:   " << msgTiming << std::endl;
     std::cout << "KB/sec:     " << xferTiming/1024.0 << std::endl;
+    profile.report(std::cout);
+    tlb.report(std::cout, buffer, nmsg);
 
     for (auto p : pullers) {
         delete p;
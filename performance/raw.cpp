@@ -0,0 +1,497 @@
+// Raw socket baseline for the pair benchmark.  Same command line and
+// output as pair, but the messages go over a plain TCP or UNIX domain
+// socket with no nng in between, so the pair (and the other pattern)
+// numbers can be read as a percentage of what the kernel can do.
+// Usage:
+//    raw uri nmsg msgsize [mode]
+//
+//      uri - tcp://host:port or ipc:///path (a UNIX domain socket).
+//      nmsg - Number of messages.
+//      msgsize - size in bytes of each message to be sent.
+//      mode - how the sender writes (default plain):
+//             plain    - one writev (length header + body) per message.
+//                        This is what nng's tcp/ipc transports do.
+//             writev   - PERF_RAW_BATCH (default 16) messages per writev.
+//             zerocopy - plain but sendmsg with MSG_ZEROCOPY (tcp only;
+//                        the kernel copies anyway over loopback - the
+//                        completions that say so are counted).
+//             uring    - batches as writev, submitted as linked writes
+//                        through io_uring, PERF_RAW_DEPTH (default 8) at a
+//                        time.
+//
+//  As in nng every message is framed by an 8 byte big endian length.
+//  The receiver thread listens, reads the stream in large chunks and
+//  counts the frames.  TCP_NODELAY is set as nng does.
+//
+//  The timing is as for pair: from the start of sending to the receiver
+//  having every message, reported as:
+//       * Total time to send the messages.
+//       * message/second
+//       * kbytes/sec.
+//
+
+#include <thread>
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <netdb.h>
+#include <endian.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/errqueue.h>
+#include <linux/io_uring.h>
+
+#include "perfutil.h"
+
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED 1
+#endif
+
+
+/**
+ *  Where to connect - parsed from the URI.
+ */
+struct Endpoint {
+    sockaddr_storage addr;
+    socklen_t        len;
+    bool             tcp;
+};
+
+static Endpoint
+parseUri(const std::string& uri) {
+    Endpoint result;
+    memset(&result, 0, sizeof(result));
+    if (uri.compare(0, 6, "ipc://") == 0) {
+        sockaddr_un* pAddr = reinterpret_cast<sockaddr_un*>(&result.addr);
+        pAddr->sun_family = AF_UNIX;
+        strncpy(pAddr->sun_path, uri.c_str() + 6, sizeof(pAddr->sun_path) - 1);
+        result.len = sizeof(sockaddr_un);
+        result.tcp = false;
+        return result;
+    }
+    if (uri.compare(0, 6, "tcp://") != 0 || uri.rfind(':') < 6) {
+        std::cerr << "URI must be tcp://host:port or ipc:///path - " << uri << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    size_t colon = uri.rfind(':');
+    std::string host = uri.substr(6, colon - 6);
+    std::string port = uri.substr(colon + 1);
+    addrinfo hints;
+    addrinfo* pInfo;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    int status = getaddrinfo(host.c_str(), port.c_str(), &hints, &pInfo);
+    if (status) {
+        std::cerr << "Unable to resolve " << host << ": " << gai_strerror(status) << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    memcpy(&result.addr, pInfo->ai_addr, pInfo->ai_addrlen);
+    result.len = pInfo->ai_addrlen;
+    result.tcp = true;
+    freeaddrinfo(pInfo);
+    return result;
+}
+
+static int
+openSocket(const Endpoint& ep) {
+    int fd = socket(ep.addr.ss_family, SOCK_STREAM, 0);
+    checkerr(fd, "Unable to make a socket");
+    if (ep.tcp) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    }
+    return fd;
+}
+
+/**
+ * receiver
+ *    Accept one connection and count nmsg frames off it.
+ */
+static void
+receiver(int listener, size_t nmsg) {
+    int fd = accept(listener, nullptr, nullptr);
+    checkerr(fd, "Receiver accept failed");
+
+    std::vector<uint8_t> chunk(1024*1024);
+    uint8_t  header[sizeof(uint64_t)];
+    size_t   headerGot = 0;
+    uint64_t bodyLeft = 0;
+    size_t   received = 0;
+    while (received < nmsg) {
+        ssize_t n = read(fd, chunk.data(), chunk.size());
+        checkerr(n, "Receiver read failed");
+        if (n == 0) {
+            std::cerr << "Sender closed after " << received << " messages\n";
+            exit(EXIT_FAILURE);
+        }
+        size_t pos = 0;
+        while (pos < n) {
+            if (headerGot < sizeof(header)) {
+                size_t take = std::min<size_t>(sizeof(header) - headerGot, n - pos);
+                memcpy(header + headerGot, &chunk[pos], take);
+                headerGot += take;
+                pos += take;
+                if (headerGot < sizeof(header)) break;
+                uint64_t len;
+                memcpy(&len, header, sizeof(len));
+                bodyLeft = be64toh(len);
+            }
+            size_t take = std::min<uint64_t>(bodyLeft, n - pos);
+            bodyLeft -= take;
+            pos += take;
+            if (bodyLeft == 0) {
+                received++;
+                headerGot = 0;
+            }
+        }
+    }
+    close(fd);
+}
+
+// Sending.  All messages are the same so one header and one body serve.
+
+static uint64_t       header;
+static uint8_t*       pBody;
+static size_t         bodySize;
+static size_t         zcCompletions(0);     // MSG_ZEROCOPY notifications.
+static size_t         zcCopied(0);          // ... where the kernel copied.
+
+/**
+ * fillIov
+ *    Fill iov with count messages.
+ */
+static void
+fillIov(std::vector<iovec>& iov, size_t count) {
+    iov.resize(2*count);
+    for (size_t i = 0; i < count; i++) {
+        iov[2*i].iov_base   = &header;
+        iov[2*i].iov_len    = sizeof(header);
+        iov[2*i+1].iov_base = pBody;
+        iov[2*i+1].iov_len  = bodySize;
+    }
+}
+
+/**
+ * drainZerocopy
+ *    Collect MSG_ZEROCOPY completion notifications from the error queue.
+ * @param wait - block (up to 10ms) for at least one.
+ */
+static void
+drainZerocopy(int fd, bool wait) {
+    if (wait) {
+        pollfd p = {fd, POLLERR, 0};
+        poll(&p, 1, 10);
+    }
+    while (true) {
+        char control[128];
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control    = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) return;
+        for (cmsghdr* pC = CMSG_FIRSTHDR(&msg); pC; pC = CMSG_NXTHDR(&msg, pC)) {
+            sock_extended_err* pErr = reinterpret_cast<sock_extended_err*>(CMSG_DATA(pC));
+            if (pErr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) continue;
+            size_t n = pErr->ee_data - pErr->ee_info + 1;    // Range of sends.
+            zcCompletions += n;
+            if (pErr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) zcCopied += n;
+        }
+    }
+}
+
+/**
+ * writeAll
+ *    Write the iov completely, resuming after short writes.
+ *  flags non zero means sendmsg with those flags.
+ */
+static void
+writeAll(int fd, iovec* pIov, size_t count, int flags) {
+    while (count) {
+        ssize_t n;
+        if (flags) {
+            msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov    = pIov;
+            msg.msg_iovlen = std::min<size_t>(count, IOV_MAX);
+            n = sendmsg(fd, &msg, flags);
+            if (n < 0 && errno == ENOBUFS) {       // Too many zerocopy sends pending.
+                drainZerocopy(fd, true);
+                continue;
+            }
+        } else {
+            n = writev(fd, pIov, std::min<size_t>(count, IOV_MAX));
+        }
+        if (n < 0 && errno == EINTR) continue;
+        checkerr(n, "Sender write failed");
+        while (count && n >= (ssize_t)pIov->iov_len) {
+            n -= pIov->iov_len;
+            pIov++;
+            count--;
+        }
+        if (count) {
+            pIov->iov_base = reinterpret_cast<uint8_t*>(pIov->iov_base) + n;
+            pIov->iov_len -= n;
+        }
+    }
+}
+
+/**
+ * Uring
+ *    Just enough io_uring (by the raw system calls) to submit linked
+ *  writev's to one socket and reap their completions.
+ */
+class Uring {
+public:
+    explicit Uring(unsigned entries) {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        m_fd = syscall(__NR_io_uring_setup, entries, &params);
+        checkerr(m_fd, "io_uring_setup failed");
+
+        size_t sqSize = params.sq_off.array + params.sq_entries*sizeof(unsigned);
+        size_t cqSize = params.cq_off.cqes + params.cq_entries*sizeof(io_uring_cqe);
+        bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) sqSize = cqSize = std::max(sqSize, cqSize);
+        uint8_t* pSq = map(sqSize, IORING_OFF_SQ_RING);
+        uint8_t* pCq = single ? pSq : map(cqSize, IORING_OFF_CQ_RING);
+        m_pSqes = reinterpret_cast<io_uring_sqe*>(
+            map(params.sq_entries*sizeof(io_uring_sqe), IORING_OFF_SQES)
+        );
+        m_pSqTail  = reinterpret_cast<unsigned*>(pSq + params.sq_off.tail);
+        m_sqMask   = *reinterpret_cast<unsigned*>(pSq + params.sq_off.ring_mask);
+        m_pSqArray = reinterpret_cast<unsigned*>(pSq + params.sq_off.array);
+        m_pCqHead  = reinterpret_cast<unsigned*>(pCq + params.cq_off.head);
+        m_pCqTail  = reinterpret_cast<unsigned*>(pCq + params.cq_off.tail);
+        m_cqMask   = *reinterpret_cast<unsigned*>(pCq + params.cq_off.ring_mask);
+        m_pCqes    = reinterpret_cast<io_uring_cqe*>(pCq + params.cq_off.cqes);
+    }
+    ~Uring() {
+        close(m_fd);
+    }
+
+    // Queue a writev linked to the next one queued (if link).
+    void writev(int fd, const iovec* pIov, unsigned count, uint64_t data, bool link) {
+        unsigned tail = *m_pSqTail;
+        unsigned index = tail & m_sqMask;
+        io_uring_sqe* pSqe = &m_pSqes[index];
+        memset(pSqe, 0, sizeof(*pSqe));
+        pSqe->opcode    = IORING_OP_WRITEV;
+        pSqe->fd        = fd;
+        pSqe->addr      = reinterpret_cast<uint64_t>(pIov);
+        pSqe->len       = count;
+        pSqe->user_data = data;
+        pSqe->flags     = link ? IOSQE_IO_LINK : 0;
+        m_pSqArray[index] = index;
+        __atomic_store_n(m_pSqTail, tail + 1, __ATOMIC_RELEASE);
+    }
+    // Submit n and wait for n completions, reaping them into results
+    // by user_data.
+    void run(unsigned n, std::vector<int>& results) {
+        checkerr(
+            syscall(__NR_io_uring_enter, m_fd, n, n, IORING_ENTER_GETEVENTS, nullptr, 0),
+            "io_uring_enter failed"
+        );
+        unsigned reaped = 0;
+        while (reaped < n) {
+            unsigned head = *m_pCqHead;
+            if (head == __atomic_load_n(m_pCqTail, __ATOMIC_ACQUIRE)) {
+                checkerr(
+                    syscall(__NR_io_uring_enter, m_fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0),
+                    "io_uring_enter failed"
+                );
+                continue;
+            }
+            io_uring_cqe& cqe = m_pCqes[head & m_cqMask];
+            results[cqe.user_data] = cqe.res;
+            __atomic_store_n(m_pCqHead, head + 1, __ATOMIC_RELEASE);
+            reaped++;
+        }
+    }
+
+private:
+    uint8_t* map(size_t size, off_t offset) {
+        void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, offset);
+        if (p == MAP_FAILED) checkerr(-1, "io_uring mmap failed");
+        return reinterpret_cast<uint8_t*>(p);
+    }
+
+    int           m_fd;
+    io_uring_sqe* m_pSqes;
+    unsigned*     m_pSqTail;
+    unsigned      m_sqMask;
+    unsigned*     m_pSqArray;
+    unsigned*     m_pCqHead;
+    unsigned*     m_pCqTail;
+    unsigned      m_cqMask;
+    io_uring_cqe* m_pCqes;
+};
+
+/**
+ * sendUring
+ *    Send in batches of batch messages, depth linked writevs at a time.
+ *  A short write breaks the link: that write is finished and the
+ *  cancelled ones after it redone synchronously, in order.
+ */
+static void
+sendUring(int fd, size_t nmsg, size_t batch, unsigned depth) {
+    Uring ring(depth);
+    std::vector<std::vector<iovec>> iovs(depth);
+    std::vector<size_t> counts(depth);
+    std::vector<int> results(depth);
+    size_t sent = 0;
+    while (sent < nmsg) {
+        unsigned n = 0;
+        while (n < depth && sent < nmsg) {
+            counts[n] = std::min(batch, nmsg - sent);
+            fillIov(iovs[n], counts[n]);
+            sent += counts[n];
+            n++;
+        }
+        for (unsigned i = 0; i < n; i++) {
+            ring.writev(fd, iovs[i].data(), iovs[i].size(), i, i + 1 < n);
+        }
+        ring.run(n, results);
+        for (unsigned i = 0; i < n; i++) {
+            size_t expected = counts[i]*(sizeof(header) + bodySize);
+            int res = results[i];
+            if (res == (ssize_t)expected) continue;
+            if (res == -ECANCELED) res = 0;
+            if (res < 0) {
+                errno = -res;
+                checkerr(-1, "io_uring writev failed");
+            }
+            std::vector<iovec> rest;                 // Skip what was written.
+            fillIov(rest, counts[i]);
+            size_t first = 0;
+            size_t done = res;
+            while (done >= rest[first].iov_len) {
+                done -= rest[first].iov_len;
+                first++;
+            }
+            rest[first].iov_base = reinterpret_cast<uint8_t*>(rest[first].iov_base) + done;
+            rest[first].iov_len -= done;
+            writeAll(fd, &rest[first], rest.size() - first, 0);
+        }
+    }
+}
+
+/**
+ * sender
+ *    Connect and send nmsg messages in the chosen mode.
+ */
+static void
+sender(const Endpoint& ep, size_t nmsg, const std::string& mode) {
+    int fd = openSocket(ep);
+    checkerr(connect(fd, reinterpret_cast<const sockaddr*>(&ep.addr), ep.len), "Sender connect failed");
+
+    size_t batch = getenv("PERF_RAW_BATCH") ? atol(getenv("PERF_RAW_BATCH")) : 16;
+    batch = std::max<size_t>(1, std::min<size_t>(batch, IOV_MAX/2));
+    unsigned depth = getenv("PERF_RAW_DEPTH") ? atoi(getenv("PERF_RAW_DEPTH")) : 8;
+
+    std::vector<iovec> iov;
+    if (mode == "writev") {
+        for (size_t sent = 0; sent < nmsg; sent += batch) {
+            size_t count = std::min(batch, nmsg - sent);
+            fillIov(iov, count);
+            writeAll(fd, iov.data(), iov.size(), 0);
+        }
+    } else if (mode == "uring") {
+        sendUring(fd, nmsg, batch, std::max(depth, 1u));
+    } else if (mode == "zerocopy") {
+        int one = 1;
+        checkerr(
+            setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)),
+            "SO_ZEROCOPY not supported"
+        );
+        for (size_t i = 0; i < nmsg; i++) {
+            fillIov(iov, 1);
+            writeAll(fd, iov.data(), iov.size(), MSG_ZEROCOPY);
+            if ((i % 64) == 0) drainZerocopy(fd, false);
+        }
+    } else {
+        for (size_t i = 0; i < nmsg; i++) {
+            fillIov(iov, 1);
+            writeAll(fd, iov.data(), iov.size(), 0);
+        }
+    }
+    if (mode == "zerocopy") {
+        // Wait for the outstanding notifications so they can be reported.
+        for (int i = 0; i < 100 && zcCompletions < nmsg; i++) {
+            drainZerocopy(fd, true);
+        }
+    }
+    close(fd);
+}
+
+/**
+ *  entry point.
+ */
+int main(int argc, char** argv) {
+    std::string uri(argv[1]);
+    size_t nmsg = atol(argv[2]);
+    size_t msgSize = atol(argv[3]);
+    std::string mode = (argc > 4) ? argv[4] : "plain";
+    char cr;
+
+    Endpoint ep = parseUri(uri);
+    if (!ep.tcp) {
+        unlink(reinterpret_cast<sockaddr_un*>(&ep.addr)->sun_path);
+    }
+    int listener = openSocket(ep);
+    checkerr(bind(listener, reinterpret_cast<sockaddr*>(&ep.addr), ep.len), "Receiver bind failed");
+    checkerr(listen(listener, 1), "Receiver listen failed");
+
+    header   = htobe64(msgSize);
+    bodySize = msgSize;
+    pBody    = new uint8_t[msgSize];
+    memset(pBody, 0, msgSize);
+
+    std::thread thrReceiver(receiver, listener, nmsg);
+
+    std::cout << "Hit enter to start timing: ";
+    std::cout.flush();
+    cr = std::cin.get();
+    std::cout << "Let's go\n";
+
+    auto start = std::chrono::high_resolution_clock::now();
+    sender(ep, nmsg, mode);
+    thrReceiver.join();                  // Ensures the receiver got them all.
+    auto end = std::chrono::high_resolution_clock::now();
+    auto duration = end - start;
+
+    double timing = (double)std::chrono::duration_cast<std::chrono::milliseconds>(duration).count()/1000.0;
+    double msgTiming = (double)nmsg/timing;
+    double xferTiming = (double)(nmsg * msgSize)/timing;
+
+    std::cout << "Time:       " << timing << std::endl;
+    std::cout << "msgs/sec:   " << msgTiming << std::endl;
+    std::cout << "KB/sec:     " << xferTiming/1024.0 << std::endl;
+    if (mode == "zerocopy") {
+        std::cout << "Zerocopy completions: " << zcCompletions
+                  << " copied by the kernel: " << zcCopied << std::endl;
+    }
+
+    close(listener);
+    if (!ep.tcp) {
+        unlink(reinterpret_cast<sockaddr_un*>(&ep.addr)->sun_path);
+    }
+    delete []pBody;
+    return EXIT_SUCCESS;
+}
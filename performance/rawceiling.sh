@@ -0,0 +1,65 @@
+#!/bin/bash
+
+# The nng patterns as a percentage of the raw socket ceiling (raw.cpp).
+# For each transport and size the ceiling is the best of raw's modes
+# (zerocopy is tcp only).  pair, pushpull and pubsub with one consumer
+# and reqrep (its big request timing) then run on the same transport
+# and are reported against it, and against raw plain which writes each
+# message as nng's transports do.  The table goes to stdout, the output
+# of every run to rawceiling.log.
+
+echo Raw ceiling log > rawceiling.log
+
+port=0
+next() {
+    port=$((port + 1))
+    uri=$(printf $transport $port)
+}
+rate() {
+    tee -a rawceiling.log | awk '/^msgs\/sec/ && !n++ { print $NF }'
+}
+report() {
+    printf "%-9s %8s %-13s %14s %8s %8s\n" ${transport%%:*} $size $1 "${2:--}" \
+	$(awk "BEGIN {
+	    pct(\"$2\", \"$best\"); pct(\"$2\", \"$plain\")
+	}
+	function pct(r, base) {
+	    if (r + 0 > 0 && base + 0 > 0) printf \"%.1f \", 100.0*r/base; else printf \"- \"
+	}")
+}
+
+printf "%-9s %8s %-13s %14s %8s %8s\n" transport size program msgs/sec "%raw" "%plain"
+for transport in tcp://127.0.0.1:30%03d ipc:///tmp/nngraw%d
+do
+    modes="plain writev uring zerocopy"
+    case $transport in ipc*) modes="plain writev uring";; esac
+    for size in 100 1024 65536 1048576
+    do
+	nmsg=$(( size > 65536 ? 10000 : 200000 ))
+
+	best=0
+	for mode in $modes
+	do
+	    echo ---- raw $transport $size $mode -------- >> rawceiling.log
+	    next
+	    r=$(echo | ./raw $uri $nmsg $size $mode | rate)
+	    r=${r:-0}                           # Failed runs don't count.
+	    printf "%-9s %8s %-13s %14s\n" ${transport%%:*} $size raw-$mode $r
+	    if [ $mode == plain ]; then plain=$r; fi
+	    best=$(awk "BEGIN { print ($r > $best) ? $r : $best }")
+	done
+
+	echo ---- pair $transport $size -------- >> rawceiling.log
+	next
+	report pair $(echo | ./pair $uri $nmsg $size | rate)
+	echo ---- pushpull $transport $size -------- >> rawceiling.log
+	next
+	report pushpull $(echo | ./pushpull $uri $nmsg $size 1 | rate)
+	echo ---- pubsub $transport $size -------- >> rawceiling.log
+	next
+	report pubsub $(echo | ./pubsub $uri $nmsg $size 1 | rate)
+	echo ---- reqrep $transport $size -------- >> rawceiling.log
+	next
+	report reqrep $(./reqrep $uri $(( nmsg / 10 )) $size | rate)
+    done
+done
@@ -0,0 +1,351 @@
+/**
+ *  This program measures how long it takes for traffic to start, and to
+ * resume after the listening side is killed and restarted, and how many
+ * messages are lost or stalled across the gap.  The examples just sleep
+ * (push sleeps 2s, setupBus 5s) and hope that's long enough.
+ *
+ *   Usage:
+ *      reconnect URI pattern ndialers nmsgs rate killms downms [mint [maxt]]
+ *
+ *   Where:
+ *     URI      - is the URI the receiver listens on (tcp:// or ipc:// -
+ *                the receiver is another process so not inproc://).
+ *     pattern  - push - dialers push to a listening puller.
+ *                pub  - dialers publish to a listening subscriber.
+ *                pair - one dialer (ndialers is forced to 1) to a listening
+ *                       pair.
+ *     ndialers - number of sending sockets, each in its own thread.  Many
+ *                of them all reconnecting at once is the storm.
+ *     nmsgs    - total messages, split evenly over the dialers.
+ *     rate     - total messages/sec, paced on a schedule.
+ *     killms   - ms after the start at which the receiver is SIGKILLed.
+ *     downms   - ms the receiver stays dead before it's restarted.
+ *     mint     - NNG_OPT_RECONNMINT for the dialers in ms (default 100).
+ *     maxt     - NNG_OPT_RECONNMAXT for the dialers in ms (default 0 - the
+ *                reconnect interval doesn't back off).
+ *
+ *   The receiver is this program run as
+ *      reconnect listen URI pattern fd
+ *   in a child process.  It reports the sequence number and arrival time
+ *   of each message it gets down a pipe (fd).  The dialers dial with
+ *   NNG_FLAG_NONBLOCK so they keep retrying whether or not the receiver
+ *   is there, and send (blocking) on a fixed schedule.  A push or pair
+ *   send blocks while there's no peer so it falls behind the schedule
+ *   (stalls); pub drops.
+ *
+ *   Output (ms):
+ *     - Startup: time from the start until each dialer's first message
+ *       arrived (p50, max).
+ *     - Resume: time from the restart until the first message, and until
+ *       every dialer had one through.  Outage: last message before the
+ *       kill to the first after the restart.
+ *     - Messages lost (never received).
+ *     - Stalled sends (finished more than 10ms behind schedule) and the
+ *       worst lateness.
+ */
+#include <thread>
+#include <nng/nng.h>
+#include <nng/protocol/pipeline0/push.h>
+#include <nng/protocol/pipeline0/pull.h>
+#include <nng/protocol/pubsub0/pub.h>
+#include <nng/protocol/pubsub0/sub.h>
+#include <nng/protocol/pair0/pair.h>
+
+#include <iostream>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "trace.h"
+#include "netns.h"
+#include "perfutil.h"
+
+
+/**
+ * sleepUntil
+ *    Absolute sleep on CLOCK_MONOTONIC.
+ */
+static void
+sleepUntil(uint64_t ns) {
+    struct timespec t;
+    t.tv_sec  = ns / 1000000000;
+    t.tv_nsec = ns % 1000000000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, nullptr) == EINTR)
+        ;
+}
+
+static const uint64_t STALL_NS(10*1000*1000);   // Later than this is stalled.
+
+/**
+ *  The receiver's report of each message.
+ */
+struct Arrival {
+    uint64_t seq;
+    uint64_t at;
+};
+
+/**
+ * listener
+ *    The receiving process: listen and report every arrival until
+ *  killed.
+ *
+ * @param uri     - where to listen.
+ * @param pattern - push, pub or pair (the sender's side).
+ * @param fd      - pipe to report on.
+ */
+static void
+listener(const std::string& uri, const std::string& pattern, int fd) {
+    nng_socket s;
+    if (pattern == "push") {
+        checkstat(nng_pull0_open(&s), "Unable to open a pull socket.");
+    } else if (pattern == "pub") {
+        checkstat(nng_sub0_open(&s), "Unable to open a sub socket.");
+        checkstat(
+            nng_setopt(s, NNG_OPT_SUB_SUBSCRIBE, "", 0),
+            "Could not set subscription"
+        );
+    } else {
+        checkstat(nng_pair0_open(&s), "Unable to open a pair socket.");
+    }
+    checkstat(
+        perfListen(s, uri.c_str(), nullptr, 0),
+        "Receiver could not listen"
+    );
+    while (true) {
+        void*  pMsg;
+        size_t size;
+        checkstat(
+            tracedRecv(s, &pMsg, &size, NNG_FLAG_ALLOC),
+            "Receiver failed to receive"
+        );
+        Arrival arrival;
+        memcpy(&arrival.seq, pMsg, sizeof(arrival.seq));
+        arrival.at = now();
+        nng_free(pMsg, size);
+        if (write(fd, &arrival, sizeof(arrival)) != sizeof(arrival)) {
+            exit(EXIT_FAILURE);               // Parent's gone.
+        }
+    }
+}
+
+/**
+ * startListener
+ *    Fork/exec ourselves as the receiver.  We exec because the parent
+ *  has nng threads and those don't survive a fork.
+ *
+ * @return pid_t - the receiver's pid.
+ */
+static pid_t
+startListener(const char* self, const std::string& uri, const std::string& pattern, int fd) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        std::string fdText = std::to_string(fd);
+        execl(
+            self, self, "listen", uri.c_str(), pattern.c_str(), fdText.c_str(),
+            static_cast<char*>(nullptr)
+        );
+        _exit(EXIT_FAILURE);
+    }
+    if (pid < 0) {
+        perror("fork failed");
+        exit(EXIT_FAILURE);
+    }
+    return pid;
+}
+
+/**
+ * sender
+ *    One dialer: send our share of the sequence numbers on schedule.
+ *
+ * @param uri      - receiver's URI.
+ * @param pattern  - push, pub or pair.
+ * @param first    - our first sequence number.
+ * @param nmsg     - how many we send.
+ * @param start    - time of the first send.
+ * @param period   - ns between our sends.
+ * @param mint     - RECONNMINT (ms).
+ * @param maxt     - RECONNMAXT (ms).
+ * @param pLateness[out] - how far behind schedule each send finished (ns).
+ */
+static void
+sender(
+    std::string uri, std::string pattern, uint64_t first, size_t nmsg,
+    uint64_t start, uint64_t period, int mint, int maxt,
+    std::vector<uint64_t>* pLateness
+) {
+    nng_socket s;
+    if (pattern == "push") {
+        checkstat(nng_push0_open(&s), "Unable to open a push socket.");
+    } else if (pattern == "pub") {
+        checkstat(nng_pub0_open(&s), "Unable to open a pub socket.");
+    } else {
+        checkstat(nng_pair0_open(&s), "Unable to open a pair socket.");
+    }
+    checkstat(
+        nng_setopt_ms(s, NNG_OPT_RECONNMINT, mint),
+        "Unable to set the reconnect minimum"
+    );
+    checkstat(
+        nng_setopt_ms(s, NNG_OPT_RECONNMAXT, maxt),
+        "Unable to set the reconnect maximum"
+    );
+    checkstat(
+        nng_dial(s, uri.c_str(), nullptr, NNG_FLAG_NONBLOCK),
+        "Unable to start dialing"
+    );
+
+    uint8_t message[64];
+    memset(message, 0, sizeof(message));
+    for (int i = 0; i < nmsg; i++) {
+        uint64_t due = start + i*period;
+        sleepUntil(due);
+        uint64_t seq = first + i;
+        memcpy(message, &seq, sizeof(seq));
+        checkstat(
+            tracedSend(s, message, sizeof(message), 0),
+            "Failed to send"
+        );
+        pLateness->push_back(now() - due);
+    }
+    sleep(1);                         // Let the last few drain.
+    nng_close(s);
+}
+
+/**
+ *  Entry point
+ * @note - this is not production code so missing command line
+ * parameters most likely result in a segfault.
+ */
+int main(int argc, char** argv) {
+    if (std::string(argv[1]) == "listen") {
+        listener(argv[2], argv[3], atoi(argv[4]));
+        return EXIT_SUCCESS;
+    }
+    std::string uri(argv[1]);
+    std::string pattern(argv[2]);
+    size_t   ndialers = atol(argv[3]);
+    size_t   nmsg     = atol(argv[4]);
+    double   rate     = atof(argv[5]);
+    uint64_t killms   = atol(argv[6]);
+    uint64_t downms   = atol(argv[7]);
+    int      mint     = (argc > 8) ? atoi(argv[8]) : 100;
+    int      maxt     = (argc > 9) ? atoi(argv[9]) : 0;
+
+    if (pattern == "pair") ndialers = 1;
+    size_t perDialer = nmsg / ndialers;
+    nmsg = perDialer * ndialers;
+
+    int results[2];
+    if (pipe(results)) {
+        perror("Unable to make the results pipe");
+        exit(EXIT_FAILURE);
+    }
+    pid_t receiver = startListener("/proc/self/exe", uri, pattern, results[1]);
+
+    // Collect the arrivals as they come (the write end stays open in
+    // this process so reads don't see EOF between receivers).
+
+    std::vector<Arrival> arrivals;
+    arrivals.reserve(nmsg);
+    std::thread collector([&arrivals, fd = results[0]] {
+        Arrival a;
+        while (read(fd, &a, sizeof(a)) == sizeof(a)) {
+            arrivals.push_back(a);
+        }
+    });
+
+    // Senders, each with the same schedule shifted so the total rate
+    // is evenly spread:
+
+    uint64_t period = static_cast<uint64_t>(1.0e9 * ndialers / rate);
+    uint64_t start  = now() + 100*1000*1000;       // Time to get the threads going.
+    std::vector<std::vector<uint64_t>> lateness(ndialers);
+    std::vector<std::thread*> senders;
+    for (int i = 0; i < ndialers; i++) {
+        lateness[i].reserve(perDialer);
+        senders.push_back(new std::thread(
+            sender, uri, pattern, i*perDialer, perDialer,
+            start + i*(period/ndialers), period, mint, maxt, &lateness[i]
+        ));
+    }
+
+    // Kill and restart the receiver:
+
+    uint64_t killAt = start + killms*1000*1000;
+    sleepUntil(killAt);
+    kill(receiver, SIGKILL);
+    waitpid(receiver, nullptr, 0);
+    killAt = now();
+    sleepUntil(killAt + downms*1000*1000);
+    uint64_t restartAt = now();
+    receiver = startListener("/proc/self/exe", uri, pattern, results[1]);
+
+    for (auto p : senders) {
+        p->join();
+        delete p;
+    }
+    kill(receiver, SIGKILL);
+    waitpid(receiver, nullptr, 0);
+    close(results[1]);
+    collector.join();
+
+    // Analysis:
+
+    std::vector<bool>     got(nmsg, false);
+    std::vector<uint64_t> firstAt(ndialers, 0);     // First arrival per dialer.
+    std::vector<uint64_t> resumedAt(ndialers, 0);   // First after the restart.
+    uint64_t lastBeforeKill = start;
+    uint64_t firstAfterRestart = 0;
+    size_t   received = 0;
+    for (auto& a : arrivals) {
+        if (a.seq >= nmsg || got[a.seq]) continue;
+        got[a.seq] = true;
+        received++;
+        size_t d = a.seq / perDialer;
+        if (!firstAt[d] || a.at < firstAt[d]) firstAt[d] = a.at;
+        if (a.at < killAt) {
+            lastBeforeKill = std::max(lastBeforeKill, a.at);
+        } else if (a.at >= restartAt) {
+            if (!resumedAt[d] || a.at < resumedAt[d]) resumedAt[d] = a.at;
+            if (!firstAfterRestart || a.at < firstAfterRestart) firstAfterRestart = a.at;
+        }
+    }
+    std::vector<uint64_t> startup, resume, late;
+    size_t neverResumed = 0;
+    for (int d = 0; d < ndialers; d++) {
+        if (firstAt[d]) startup.push_back(firstAt[d] - start);
+        if (resumedAt[d]) {
+            resume.push_back(resumedAt[d] - restartAt);
+        } else {
+            neverResumed++;
+        }
+        late.insert(late.end(), lateness[d].begin(), lateness[d].end());
+    }
+    std::sort(startup.begin(), startup.end());
+    std::sort(resume.begin(), resume.end());
+    std::sort(late.begin(), late.end());
+    size_t stalled = late.end() - std::upper_bound(late.begin(), late.end(), STALL_NS);
+
+    std::cout << pattern << " " << uri << " dialers " << ndialers
+              << " reconnect min/max (ms) " << mint << "/" << maxt << std::endl;
+    std::cout << "Startup (ms) p50:           " << percentile(startup, 50.0, 1.0e6) << std::endl;
+    std::cout << "Startup (ms) max:           " << percentile(startup, 100.0, 1.0e6) << std::endl;
+    std::cout << "Down (ms):                  " << (restartAt - killAt)/1.0e6 << std::endl;
+    std::cout << "Resume (ms) first:          " << (firstAfterRestart ? (firstAfterRestart - restartAt)/1.0e6 : -1.0) << std::endl;
+    std::cout << "Resume (ms) all dialers:    " << percentile(resume, 100.0, 1.0e6) << std::endl;
+    std::cout << "Dialers never resumed:      " << neverResumed << std::endl;
+    std::cout << "Outage (ms):                " << (firstAfterRestart ? (firstAfterRestart - lastBeforeKill)/1.0e6 : -1.0) << std::endl;
+    std::cout << "Messages sent:              " << nmsg << std::endl;
+    std::cout << "Messages lost:              " << nmsg - received << std::endl;
+    std::cout << "Stalled sends (>10ms late): " << stalled << std::endl;
+    std::cout << "Worst lateness (ms):        " << percentile(late, 100.0, 1.0e6) << std::endl;
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,22 @@
+#!/bin/bash
+
+# Receiver kill/restart: 20000 msgs at 2000/sec (10 sec), receiver killed
+# 3 sec in and down for 1 sec.  Varies the transport, the number of
+# dialers and the reconnect interval settings (min/max ms).
+
+echo Reconnect log > reconnect.log
+
+for service in tcp://localhost:3000 ipc:///tmp/reconnect
+do
+    for pattern in push pub pair
+    do
+	for dialers in 1 100
+	do
+	    for reconnect in "10 0" "100 0" "100 1000" "1000 0"
+	    do
+		echo ---- $service $pattern $dialers dialers reconnect $reconnect -------- >> reconnect.log
+		./reconnect $service $pattern $dialers 20000 2000 3000 1000 $reconnect >> reconnect.log
+	    done
+	done
+    done
+done
@@ -0,0 +1,130 @@
+/**
+ * Receive modes shared by the performance programs.
+ *
+ * By default receivers block in nng_recv so every measured latency
+ * includes the cost of waking the receiving thread.  Two environment
+ * variables change that for every program that receives through
+ * perfRecv (or perfRecvMsg) and calls perfReceiverSetup at the start of its receiving
+ * threads:
+ *
+ *   PERF_RECV_SPIN_US=n  - Busy poll with NNG_FLAG_NONBLOCK for up to n
+ *                          microseconds before falling back to a blocking
+ *                          nng_recv.  This trades a CPU per receiver for
+ *                          not sleeping between closely spaced messages.
+ *   PERF_RECV_RT=prio    - Run receiving threads SCHED_FIFO at priority
+ *                          prio (1-99) and mlockall the process so page
+ *                          faults don't add jitter.  Needs CAP_SYS_NICE /
+ *                          CAP_IPC_LOCK (or root); failures are reported
+ *                          and the run continues without them.
+ *
+ * Use these on dedicated cores - a spinning SCHED_FIFO thread can
+ * starve anything else on its CPU.
+ */
+#ifndef RECVMODE_H
+#define RECVMODE_H
+
+#include <nng/nng.h>
+
+#include <atomic>
+#include <iostream>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#include "trace.h"
+#include "perfutil.h"
+
+/**
+ * recvSpinNs
+ *   @return uint64_t - nanoseconds to busy poll before blocking (0 - don't).
+ */
+static inline uint64_t
+recvSpinNs() {
+    static const uint64_t spin = getenv("PERF_RECV_SPIN_US") ?
+        strtoull(getenv("PERF_RECV_SPIN_US"), nullptr, 0) * 1000 : 0;
+    return spin;
+}
+
+/**
+ * perfRecv
+ *    nng_recv with NNG_FLAG_ALLOC in the configured receive mode.
+ *  The blocking fallback keeps any receive timeout semantics.  Traced
+ *  as "recv" (see trace.h).
+ *
+ * @param s     - socket to receive on.
+ * @param pData - where the received buffer pointer goes (nng_free it).
+ * @param pSize - where the received size goes.
+ * @return int  - nng status.
+ */
+static inline int
+perfRecv(nng_socket s, void* pData, size_t* pSize) {
+    TraceScope trace("recv", traceNextRecv());
+    uint64_t spin = recvSpinNs();
+    if (spin) {
+        uint64_t end = now() + spin;
+        do {
+            int status = nng_recv(s, pData, pSize, NNG_FLAG_ALLOC | NNG_FLAG_NONBLOCK);
+            if (status != NNG_EAGAIN) {
+                return status;
+            }
+        } while (now() < end);
+    }
+    return nng_recv(s, pData, pSize, NNG_FLAG_ALLOC);
+}
+
+/**
+ * perfRecvMsg
+ *    nng_recvmsg in the configured receive mode, for receivers that
+ *  pass the message on (e.g. echo it) without copying the body.
+ *  Traced as "recv".
+ *
+ * @param s     - socket to receive on.
+ * @param ppMsg - where the received message goes (nng_msg_free it or
+ *                send it on).
+ * @return int  - nng status.
+ */
+static inline int
+perfRecvMsg(nng_socket s, nng_msg** ppMsg) {
+    TraceScope trace("recv", traceNextRecv());
+    uint64_t spin = recvSpinNs();
+    if (spin) {
+        uint64_t end = now() + spin;
+        do {
+            int status = nng_recvmsg(s, ppMsg, NNG_FLAG_NONBLOCK);
+            if (status != NNG_EAGAIN) {
+                return status;
+            }
+        } while (now() < end);
+    }
+    return nng_recvmsg(s, ppMsg, 0);
+}
+
+/**
+ * perfReceiverSetup
+ *    Call at the start of a receiving thread.  Applies PERF_RECV_RT.
+ */
+static inline void
+perfReceiverSetup() {
+    const char* rt = getenv("PERF_RECV_RT");
+    if (!rt) return;
+
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = atoi(rt);
+    int status = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (status) {
+        std::cerr << "Unable to set SCHED_FIFO: " << strerror(status) << std::endl;
+    }
+    static std::atomic<bool> locked(false);   // Once per process is enough.
+    if (!locked.exchange(true)) {
+        if (mlockall(MCL_CURRENT | MCL_FUTURE)) {
+            std::cerr << "Unable to mlockall: " << strerror(errno) << std::endl;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,25 @@
+#!/bin/bash
+
+# Round trip latency and CPU cost of the receive modes in recvmode.h:
+#   blocking           - the default.
+#   spin               - busy poll for up to 50us before blocking.
+#   spin + SCHED_FIFO  - as above with real time priority and mlockall
+#                        (needs root or CAP_SYS_NICE/CAP_IPC_LOCK).
+
+echo Receive mode log > recvmode.log
+
+for service in tcp://localhost:3000 ipc:///tmp/recvmode inproc://recvmode
+do
+    for size in 16 1024 65536
+    do
+	echo ----    $service size $size blocking -------- >> recvmode.log
+	./pingpong $service 100000 $size 1000 >> recvmode.log
+
+	echo ----    $service size $size spin -------- >> recvmode.log
+	PERF_RECV_SPIN_US=50 ./pingpong $service 100000 $size 1000 >> recvmode.log
+
+	echo ----    $service size $size spin+fifo -------- >> recvmode.log
+	PERF_RECV_SPIN_US=50 PERF_RECV_RT=50 \
+	    ./pingpong $service 100000 $size 1000 >> recvmode.log
+    done
+done
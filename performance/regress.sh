@@ -0,0 +1,31 @@
+#!/bin/bash
+
+# Regression check for nng and kernel upgrades.  Runs the pattern
+# benchmarks PERF_REPS times each into results/current.txt and compares
+# that with results/baseline.txt, exiting non-zero on any regression
+# beyond noise.  With no baseline yet (or with "regress.sh baseline") the
+# run becomes the baseline.
+
+mkdir -p results
+out=results/current.txt
+rm -f $out
+
+for size in 100 65536
+do
+    ./repeat.sh $out pair-$size ./pair tcp://localhost:3000 100000 $size
+    ./repeat.sh $out pushpull-$size ./pushpull tcp://localhost:3001 100000 $size 4
+    ./repeat.sh $out pubsub-$size ./pubsub tcp://localhost:3002 100000 $size 4
+    ./repeat.sh $out reqrep-$size ./reqrep tcp://localhost:3003 100000 $size
+    ./repeat.sh $out survey-$size ./survey tcp://localhost:3004 10000 $size 4
+    ./repeat.sh $out pingpong-$size ./pingpong tcp://localhost:3005 100000 $size 1000
+done
+
+./perfstats summary $out > results/summary.txt
+
+if [ "$1" == "baseline" ] || [ ! -f results/baseline.txt ]
+then
+    cp $out results/baseline.txt
+    echo New baseline results/baseline.txt
+    exit 0
+fi
+./perfstats compare results/baseline.txt $out ${PERF_THRESHOLD:-2}
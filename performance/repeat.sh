@@ -0,0 +1,32 @@
+#!/bin/bash
+
+# Run a benchmark several times and collect its results for perfstats:
+#
+#    repeat.sh results run command [args...]
+#
+# The command is run PERF_REPS times (default 10), with a newline on its
+# input for the programs that wait for Enter.  Every "label: number" line
+# it prints is appended to results as "run/label<TAB>number"; a label
+# printed more than once in a run (e.g. reqrep's two msgs/sec) becomes
+# label#2, label#3...  Then:
+#
+#    perfstats summary results             - mean, stddev, median + CI...
+#    perfstats compare baseline results    - fails on regressions.
+
+results=$1
+run=$2
+shift 2
+
+for ((rep = 0; rep < ${PERF_REPS:-10}; rep++))
+do
+    echo | "$@" | awk -v run="$run" '
+        match($0, /^[^:]+:[ \t]*[-+0-9.eE]+[ \t]*$/) {
+            split($0, f, ":")
+            label = f[1]
+            gsub(/^[ \t]+|[ \t]+$/, "", label)
+            if (++seen[label] > 1) label = label "#" seen[label]
+            value = f[2]
+            gsub(/[ \t]/, "", value)
+            printf "%s/%s\t%s\n", run, label, value
+        }' >> $results
+done
@@ -0,0 +1,173 @@
+/**
+ * This program is a load test for the reply example program (../reply.cpp).
+ * It measures requests/sec and request latency with many concurrent
+ * clients so the single threaded loop can be compared with the multi
+ * context server mode.
+ *
+ * Usage:
+ *     replyload uri nclients nreq [slowms]
+ *
+ * Where uri      - is the URI on which a reply program is already listening.
+ *       nclients - is the number of client threads, each with its own REQ
+ *                  socket, making DATE requests.
+ *       nreq     - is the number of requests each client makes.
+ *       slowms   - if supplied and nonzero an extra client repeatedly makes
+ *                  "SLEEP slowms" requests while the others run, modelling
+ *                  one slow request that everyone else may queue behind.
+ *
+ * Output is the elapsed time, the requests/sec for the DATE clients and
+ * their latency percentiles.  The reply program is not stopped; use
+ * ../req uri STOP for that (replyload.sh does all of this).
+ */
+#include <thread>
+#include <nng/nng.h>
+#include <nng/protocol/reqrep0/req.h>
+
+#include <iostream>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+#include <string>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#include "recvmode.h"
+#include "perfutil.h"
+
+
+static std::atomic<bool> clientsDone(false);     // Tells the slow client to quit.
+
+/**
+ * openClient
+ *    Make a REQ socket dialed to the server.
+ * @param uri - server URI.
+ * @return nng_socket
+ */
+static nng_socket
+openClient(const std::string& uri) {
+    nng_socket s;
+    checkstat(
+        nng_req0_open(&s),
+        "Could not make requester socket"
+    );
+    checkstat(
+        nng_dial(s, uri.c_str(), nullptr, 0),
+        "Could not dial the replier."
+    );
+    return s;
+}
+
+/**
+ * request
+ *    Make one request and discard the reply.
+ * @param s   - the REQ socket.
+ * @param req - null terminated request text.
+ */
+static void
+request(nng_socket s, const char* req) {
+    void*  reply;
+    size_t repsize;
+    checkstat(
+        tracedSend(s, const_cast<char*>(req), strlen(req) + 1, 0),
+        "Unable to make request"
+    );
+    checkstat(
+        perfRecv(s, &reply, &repsize),
+        "Unable to receive a reply to our request"
+    );
+    nng_free(reply, repsize);
+}
+
+/**
+ * client
+ *    Make nreq DATE requests, recording the latency of each.
+ * @param uri            - server URI.
+ * @param nreq           - number of requests.
+ * @param pLatencies[out] - latencies in ns.
+ */
+static void
+client(std::string uri, size_t nreq, std::vector<uint64_t>* pLatencies) {
+    nng_socket s = openClient(uri);
+    for (int i = 0; i < nreq; i++) {
+        uint64_t start = now();
+        request(s, "DATE");
+        pLatencies->push_back(now() - start);
+    }
+    nng_close(s);
+}
+
+/**
+ * slowClient
+ *    Make SLEEP requests until the normal clients are done.
+ * @param uri    - server URI.
+ * @param slowms - how long each request sleeps in the server.
+ * @param pCount[out] - number of slow requests made.
+ */
+static void
+slowClient(std::string uri, int slowms, size_t* pCount) {
+    nng_socket s = openClient(uri);
+    std::string req = "SLEEP " + std::to_string(slowms);
+    while (!clientsDone) {
+        request(s, req.c_str());
+        (*pCount)++;
+    }
+    nng_close(s);
+}
+
+/**
+ *  Entry point
+ * @note - this is not production code so missing command line
+ * parameters most likely result in a segfault.
+ */
+int main(int argc, char** argv) {
+    std::string uri(argv[1]);
+    size_t nclients = atol(argv[2]);
+    size_t nreq     = atol(argv[3]);
+    int    slowms   = (argc > 4) ? atoi(argv[4]) : 0;
+
+    std::vector<std::vector<uint64_t>> latencies(nclients);
+    std::vector<std::thread*> clients;
+    std::thread* slow(nullptr);
+    size_t slowCount = 0;
+
+    if (slowms > 0) {
+        slow = new std::thread(slowClient, uri, slowms, &slowCount);
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < nclients; i++) {
+        latencies[i].reserve(nreq);
+        clients.push_back(new std::thread(client, uri, nreq, &latencies[i]));
+    }
+    for (auto p : clients) {
+        p->join();
+        delete p;
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    clientsDone = true;
+    if (slow) {
+        slow->join();
+        delete slow;
+    }
+
+    std::vector<uint64_t> all;
+    for (auto& l : latencies) {
+        all.insert(all.end(), l.begin(), l.end());
+    }
+    std::sort(all.begin(), all.end());
+
+    auto duration = end - start;
+    double secs = (double)std::chrono::duration_cast<std::chrono::milliseconds>(duration).count()/1000.0;
+
+    std::cout << "Elapsed sec:    " << secs << std::endl;
+    std::cout << "req/sec    :    " << (double)(nclients * nreq)/secs << std::endl;
+    std::cout << "Slow requests:  " << slowCount << std::endl;
+    std::cout << "Latency (us) p50:   " << percentile(all, 50.0) << std::endl;
+    std::cout << "Latency (us) p99:   " << percentile(all, 99.0) << std::endl;
+    std::cout << "Latency (us) max:   " << (all.empty() ? 0.0 : all.back()/1000.0) << std::endl;
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,25 @@
+#!/bin/bash
+
+# Load test ../reply in its single threaded and multi-context modes.
+#  Usage:  ./replyload.sh [uri]
+# ../reply and ../req must have been built.
+
+uri=${1:-ipc:///tmp/replyload}
+
+echo Reply load log > replyload.log
+
+for mode in "" "16 4" "64 8"
+do
+    echo ---- reply $uri $mode ---- >> replyload.log
+    ../reply $uri $mode &
+    sleep 1
+    for slow in 0 20
+    do
+	echo clients 8 slowms $slow >> replyload.log
+	./replyload $uri 8 2000 $slow >> replyload.log
+    done
+    echo text vs binary protocol >> replyload.log
+    ./replyproto $uri 8 20000 >> replyload.log
+    ../req $uri STOP > /dev/null
+    wait
+done
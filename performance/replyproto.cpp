@@ -0,0 +1,215 @@
+/**
+ * This program compares the cost of the text and binary request
+ * protocols of the reply example program (../reply.cpp).
+ *
+ * Usage:
+ *     replyproto uri nclients nreq
+ *
+ * Where uri      - is the URI on which a reply program is already listening.
+ *       nclients - is the number of client threads, each with its own REQ
+ *                  socket.
+ *       nreq     - is the number of requests each client makes per phase.
+ *
+ * Two phases are run, first with text requests then with binary
+ * (replyproto.h) requests.  In each phase the clients alternate DATE and
+ * PID requests.
+ *
+ * Since the point is the server's per request cost, we ask the server for
+ * its PID and read its CPU time from /proc/<pid>/stat before and after
+ * each phase.  For each phase we report:
+ *     - Elapsed time and requests/sec.
+ *     - Server CPU seconds and requests per server CPU second (i.e.
+ *       requests/sec per core).
+ *     - Client CPU microseconds per request (this process, getrusage).
+ *
+ * The server is left running; use ../req uri STOP to stop it.
+ */
+#include <thread>
+#include <nng/nng.h>
+#include <nng/protocol/reqrep0/req.h>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <string>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <vector>
+
+#include "recvmode.h"
+#include "../replyproto.h"
+#include "perfutil.h"
+
+
+/**
+ * openClient
+ *    Make a REQ socket dialed to the server.
+ * @param uri - server URI.
+ * @return nng_socket
+ */
+static nng_socket
+openClient(const std::string& uri) {
+    nng_socket s;
+    checkstat(
+        nng_req0_open(&s),
+        "Could not make requester socket"
+    );
+    checkstat(
+        nng_dial(s, uri.c_str(), nullptr, 0),
+        "Could not dial the replier."
+    );
+    return s;
+}
+
+/**
+ * transact
+ *    Send a request and receive (and discard) its reply.
+ * @param s    - REQ socket.
+ * @param req  - request data.
+ * @param size - request size.
+ * @param pValue[out] - if not null, receives the value of a binary reply.
+ */
+static void
+transact(nng_socket s, const void* req, size_t size, uint64_t* pValue = nullptr) {
+    void*  reply;
+    size_t repsize;
+    checkstat(
+        tracedSend(s, const_cast<void*>(req), size, 0),
+        "Unable to make request"
+    );
+    checkstat(
+        perfRecv(s, &reply, &repsize),
+        "Unable to receive a reply to our request"
+    );
+    if (pValue && isReplyFrame(reply, repsize)) {
+        *pValue = reinterpret_cast<ReplyFrame*>(reply)->value;
+    }
+    nng_free(reply, repsize);
+}
+
+/**
+ * textClient
+ *    nreq alternating DATE/PID text requests.
+ */
+static void
+textClient(std::string uri, size_t nreq) {
+    nng_socket s = openClient(uri);
+    for (int i = 0; i < nreq; i++) {
+        const char* req = (i % 2) ? "PID" : "DATE";
+        transact(s, req, strlen(req) + 1);
+    }
+    nng_close(s);
+}
+
+/**
+ * binaryClient
+ *    nreq alternating DATE/PID binary requests.
+ */
+static void
+binaryClient(std::string uri, size_t nreq) {
+    nng_socket s = openClient(uri);
+    ReplyFrame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.magic = REPLY_FRAME_MAGIC;
+    for (int i = 0; i < nreq; i++) {
+        frame.code = (i % 2) ? OP_PID : OP_DATE;
+        transact(s, &frame, sizeof(frame));
+    }
+    nng_close(s);
+}
+
+/**
+ * serverCpu
+ *   @param pid - server process id.
+ *   @return double - user + system CPU seconds used by pid so far.
+ */
+static double
+serverCpu(pid_t pid) {
+    std::ifstream stat("/proc/" + std::to_string(pid) + "/stat");
+    std::string line;
+    std::getline(stat, line);
+
+    // Fields after the command (which may contain spaces) - utime and
+    // stime are the 12th and 13th of these.
+
+    std::istringstream fields(line.substr(line.rfind(')') + 2));
+    std::string field;
+    unsigned long utime = 0, stime = 0;
+    for (int i = 0; i < 13 && fields >> field; i++) {
+        if (i == 11) utime = std::stoul(field);
+        if (i == 12) stime = std::stoul(field);
+    }
+    return (double)(utime + stime)/sysconf(_SC_CLK_TCK);
+}
+
+/**
+ * phase
+ *    Run one phase and report it.
+ * @param title    - Heading for the output.
+ * @param client   - client thread function.
+ * @param uri      - server URI.
+ * @param nclients - number of clients.
+ * @param nreq     - requests per client.
+ * @param server   - server pid.
+ */
+static void
+phase(
+    const char* title, void (*client)(std::string, size_t),
+    const std::string& uri, size_t nclients, size_t nreq, pid_t server
+) {
+    std::vector<std::thread*> clients;
+    double serverStart = serverCpu(server);
+    double clientStart = cpuSeconds();
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (int i = 0; i < nclients; i++) {
+        clients.push_back(new std::thread(client, uri, nreq));
+    }
+    for (auto p : clients) {
+        p->join();
+        delete p;
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    double serverSecs = serverCpu(server) - serverStart;
+    double clientSecs = cpuSeconds() - clientStart;
+    double secs = (double)std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count()/1000.0;
+    double total = nclients * nreq;
+
+    std::cout << title << std::endl;
+    std::cout << "Elapsed sec:          " << secs << std::endl;
+    std::cout << "req/sec:              " << total/secs << std::endl;
+    std::cout << "Server CPU sec:       " << serverSecs << std::endl;
+    std::cout << "req/server CPU sec:   " << (serverSecs > 0 ? total/serverSecs : 0.0) << std::endl;
+    std::cout << "Client CPU us/req:    " << 1.0e6*clientSecs/total << std::endl;
+}
+
+/**
+ *  Entry point
+ * @note - this is not production code so missing command line
+ * parameters most likely result in a segfault.
+ */
+int main(int argc, char** argv) {
+    std::string uri(argv[1]);
+    size_t nclients = atol(argv[2]);
+    size_t nreq     = atol(argv[3]);
+
+    // Find out who the server is:
+
+    nng_socket s = openClient(uri);
+    ReplyFrame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.magic = REPLY_FRAME_MAGIC;
+    frame.code  = OP_PID;
+    uint64_t pid = 0;
+    transact(s, &frame, sizeof(frame), &pid);
+    nng_close(s);
+
+    phase("Text requests", textClient, uri, nclients, nreq, pid);
+    phase("Binary requests", binaryClient, uri, nclients, nreq, pid);
+
+    return EXIT_SUCCESS;
+}
@@ -4,11 +4,15 @@
  * dial in a replyer.
  * 
  * Usage, therefore is
- *     reqrep  uri nmsg msgsize
+ *     reqrep  uri nmsg msgsize [streams nstreams]
  * 
  * Where uri - is the URI on which the replier listens 
  *       nmsg - is the number of messages that will be sent.
  *       msgsize - is the size of the request
+ *       streams - if present nstreams requestor/replier pairs run at
+ *                 once, uri has a %d for the stream number and per
+ *                 stream and aggregate rates are reported for each
+ *                 of the two timings (see streams.h).
  * 
  *  Note:
  *   To minimize the impact on timing, we reply with a single
@@ -41,24 +45,14 @@
 #include <chrono>
 #include <stdlib.h>
 #include <unistd.h>
+#include <vector>
+
+#include "recvmode.h"
+#include "netns.h"
+#include "streams.h"
+#include "perfutil.h"
 
 
-/**
- * checkstat
- *    Check the status of an nng call and output a message/exit
- * if the result is not ok.
- * 
- * @param status - nng status returned from a call.
- * @param doing  - text that will describe what failed.
- * 
- */
-static void 
-checkstat(int status,  const char* doing) {
-    if (status) {
-        std::cerr << doing << ": " << nng_strerror(status) << std::endl;
-        exit(EXIT_FAILURE);
-    }
-}
 /**
  *  replier
  *    Accepts a fixed number of requests, replies to them and
@@ -75,13 +69,14 @@ static void
 replier(std::string uri, size_t nmsg, size_t repsize) {
     uint8_t* reply = new uint8_t[repsize];
     nng_socket s;
+    perfReceiverSetup();
 
     checkstat(
         nng_rep0_open(&s),
         "Unable to open reply socket."
     );
     checkstat(
-        nng_listen(s, uri.c_str(), nullptr, 0),
+        perfListen(s, uri.c_str(), nullptr, 0),
         "Reeplier unable to start listening."
     );
 
@@ -91,7 +86,7 @@ replier(std::string uri, size_t nmsg, size_t repsize) {
         size_t   reqsize;
 
         checkstat(
-            nng_recv(s, &request, &reqsize, NNG_FLAG_ALLOC),
+            perfRecv(s, &request, &reqsize),
             "Could not receive a request"
         );
         nng_free(request, reqsize);
@@ -99,7 +94,7 @@ replier(std::string uri, size_t nmsg, size_t repsize) {
         // Reply:
 
         checkstat(
-            nng_send(s, reply, repsize, 0),
+            tracedSend(s, reply, repsize, 0),
             "Could not send a reply."
         );
 
@@ -136,11 +131,11 @@ requestor(nng_socket s, size_t nmsg, size_t reqsize) {
         void *reply;
         size_t  repsize;
         checkstat(
-            nng_send(s, request, reqsize, 0),
+            tracedSend(s, request, reqsize, 0),
             "Unable to make request"
         );
         checkstat(
-            nng_recv(s, &reply, &repsize, NNG_FLAG_ALLOC),
+            perfRecv(s, &reply, &repsize),
             "Unable to receive a reply to our request"
         );
         nng_free(reply, repsize);
@@ -149,6 +144,79 @@ requestor(nng_socket s, size_t nmsg, size_t reqsize) {
     delete []request;
 }
 
+/**
+ * timedRequestor
+ *    requestor that records when it finished.
+ *
+ * @param pEnd[out] - time the last reply was received.
+ */
+static void
+timedRequestor(
+    nng_socket s, size_t nmsg, size_t reqsize,
+    std::chrono::high_resolution_clock::time_point* pEnd
+) {
+    requestor(s, nmsg, reqsize);
+    *pEnd = std::chrono::high_resolution_clock::now();
+}
+
+/**
+ * streams
+ *    One of the timings with nstreams requestor/replier pairs at once.
+ *
+ * @param uris    - URI of each stream's replier.
+ * @param nmsg    - REQ/REP pairs in each stream.
+ * @param reqsize - size of the requests.
+ * @param repsize - size of the replies.
+ * @param bytes   - bytes to count per REQ/REP pair.
+ */
+static void
+streams(
+    const std::vector<std::string>& uris, size_t nmsg, size_t reqsize,
+    size_t repsize, size_t bytes
+) {
+    size_t nstreams = uris.size();
+    std::vector<std::thread*> repliers;
+    std::vector<std::thread*> requestors;
+    std::vector<nng_socket>   sockets(nstreams);
+    std::vector<std::chrono::high_resolution_clock::time_point> ends(nstreams);
+
+    for (int i = 0; i < nstreams; i++) {
+        repliers.push_back(new std::thread(replier, uris[i], nmsg, repsize));
+    }
+    sleep(1);    /// Give the threads time to listen
+    for (int i = 0; i < nstreams; i++) {
+        checkstat(
+            nng_req0_open(&sockets[i]),
+            "Could not make requester socket"
+        );
+        checkstat(
+            nng_dial(sockets[i], uris[i].c_str(), nullptr, 0),
+            "Could not dial the replier."
+        );
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < nstreams; i++) {
+        requestors.push_back(
+            new std::thread(timedRequestor, sockets[i], nmsg, reqsize, &ends[i])
+        );
+    }
+    for (auto p : requestors) {
+        p->join();
+        delete p;
+    }
+
+    reportStreams(start, ends, nmsg, nmsg*bytes);
+
+    for (auto p : repliers) {
+        p->join();
+        delete p;
+    }
+    for (auto s : sockets) {
+        nng_close(s);
+    }
+}
+
 /**
  *  Entry point
  * @note - this is not production code so missing command line
@@ -162,6 +230,14 @@ int main(int argc, char** argv) {
     nng_socket s;
     char cr;
 
+    if (argc > 5 && std::string(argv[4]) == "streams") {
+        auto uris = constructEndpoints(uri.c_str(), atol(argv[5]));
+        std::cout << "Large request timings\n";
+        streams(uris, nmsg, msgSize, 1, msgSize);
+        std::cout << "Large reply timings\n";
+        streams(uris, nmsg, 1, msgSize, msgSize);
+        return EXIT_SUCCESS;
+    }
 
     // large request, small reply.
 
@@ -0,0 +1,207 @@
+/**
+ * Sender buffers in huge pages, and counting TLB misses.
+ *
+ * The throughput programs send from one buffer that nng_send copies
+ * into each message.  At the large message sizes that copy walks
+ * hundreds of 4KB pages per send.  SendBuffer can put the buffer in
+ * huge pages instead:
+ *
+ *   PERF_HUGEPAGES=hugetlb - mmap with MAP_HUGETLB (2MB pages must be
+ *                            reserved: echo n > /proc/sys/vm/nr_hugepages).
+ *   PERF_HUGEPAGES=thp     - a 2MB aligned mapping with
+ *                            madvise(MADV_HUGEPAGE) (transparent huge pages
+ *                            in "madvise" or "always" mode).
+ *   PERF_MLOCK=1           - also mlock the buffer.
+ * If the huge page mapping fails the buffer is an ordinary one and the
+ * report says so.  Unset, it's the new[] the programs always used.
+ *
+ * Only the sender buffer is ours to place.  nng 1.x has no allocator
+ * hook: message bodies (including MessageBuilder's pooled messages and
+ * what receivers get back with NNG_FLAG_ALLOC) come from nng's own
+ * malloc calls.  glibc 2.35 and later can put those in huge pages too,
+ * with no code change, through a tunable:
+ *
+ *   GLIBC_TUNABLES=glibc.malloc.hugetlb=1 - madvise(MADV_HUGEPAGE) malloc's
+ *                                            large blocks and heap (THP).
+ *   GLIBC_TUNABLES=glibc.malloc.hugetlb=2 - use MAP_HUGETLB pages for them.
+ * hugepages.sh runs both.
+ *
+ * TlbCounter counts the calling thread's user space dTLB load and store
+ * misses with perf_event_open (needs perf_event_paranoid <= 2, which
+ * allows user space only counting, or CAP_PERFMON).  The copy that
+ * matters runs in user space inside nng_send.  nng's own threads aren't
+ * counted; they copy from nng's messages, not from this buffer.
+ *
+ *   PERF_TLB=1             - report the buffer and the miss counts.
+ */
+#ifndef SENDBUFFER_H
+#define SENDBUFFER_H
+
+#include <iostream>
+#include <string>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+class SendBuffer {
+public:
+    explicit SendBuffer(size_t size) :
+        m_pData(nullptr), m_pMap(nullptr), m_mapSize(0), m_locked(false), m_kind("normal") {
+        const char* huge = getenv("PERF_HUGEPAGES");
+        std::string mode(huge ? huge : "");
+        if (mode == "hugetlb") {
+            m_mapSize = roundUp(size);
+            m_pMap = mmap(
+                nullptr, m_mapSize, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0
+            );
+            if (m_pMap == MAP_FAILED) {
+                std::cerr << "MAP_HUGETLB failed: " << strerror(errno) << std::endl;
+                m_pMap = nullptr;
+                m_kind = "normal (hugetlb failed)";
+            } else {
+                m_pData = reinterpret_cast<uint8_t*>(m_pMap);
+                m_kind  = "hugetlb";
+            }
+        } else if (mode == "thp") {
+            m_mapSize = roundUp(size) + HUGE_PAGE;          // Room to align.
+            m_pMap = mmap(
+                nullptr, m_mapSize, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+            );
+            if (m_pMap == MAP_FAILED) {
+                std::cerr << "mmap failed: " << strerror(errno) << std::endl;
+                m_pMap = nullptr;
+                m_kind = "normal (mmap failed)";
+            } else {
+                uintptr_t p = reinterpret_cast<uintptr_t>(m_pMap);
+                m_pData = reinterpret_cast<uint8_t*>((p + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1));
+                if (madvise(m_pData, roundUp(size), MADV_HUGEPAGE)) {
+                    std::cerr << "madvise(MADV_HUGEPAGE) failed: " << strerror(errno) << std::endl;
+                    m_kind = "normal (madvise failed)";
+                } else {
+                    m_kind = "thp";
+                }
+            }
+        }
+        if (!m_pData) {
+            m_pData = new uint8_t[size];
+        }
+        memset(m_pData, 0, size);                  // Fault it all in now.
+        m_size = size;
+
+        if (getenv("PERF_MLOCK")) {
+            if (mlock(m_pData, size)) {
+                std::cerr << "mlock failed: " << strerror(errno) << std::endl;
+            } else {
+                m_locked = true;
+            }
+        }
+    }
+    ~SendBuffer() {
+        if (m_locked) munlock(m_pData, m_size);
+        if (m_pMap) {
+            munmap(m_pMap, m_mapSize);
+        } else {
+            delete []m_pData;
+        }
+    }
+    SendBuffer(const SendBuffer&) = delete;
+    SendBuffer& operator=(const SendBuffer&) = delete;
+
+    uint8_t* data() { return m_pData; }
+
+    /**
+     * kind
+     *   @return std::string - what the buffer ended up in.
+     */
+    std::string kind() const {
+        return m_kind + (m_locked ? " mlocked" : "");
+    }
+
+private:
+    static const size_t HUGE_PAGE = 2*1024*1024;
+    static size_t roundUp(size_t size) {
+        return (size + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1);
+    }
+
+    uint8_t*    m_pData;
+    void*       m_pMap;                         // Non null if mmapped.
+    size_t      m_mapSize;
+    size_t      m_size;
+    bool        m_locked;
+    std::string m_kind;
+};
+
+class TlbCounter {
+public:
+    /**
+     *  Start counting the calling thread's dTLB misses.
+     */
+    TlbCounter() : m_enabled(getenv("PERF_TLB") != nullptr), m_loads(-1), m_stores(-1) {
+        if (!m_enabled) return;
+        m_loads  = open(PERF_COUNT_HW_CACHE_RESULT_MISS, PERF_COUNT_HW_CACHE_OP_READ);
+        m_stores = open(PERF_COUNT_HW_CACHE_RESULT_MISS, PERF_COUNT_HW_CACHE_OP_WRITE);
+        for (int fd : {m_loads, m_stores}) {
+            if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+    ~TlbCounter() {
+        if (m_loads >= 0) close(m_loads);
+        if (m_stores >= 0) close(m_stores);
+    }
+    TlbCounter(const TlbCounter&) = delete;
+    TlbCounter& operator=(const TlbCounter&) = delete;
+
+    /**
+     * report
+     *    Stop counting and, if PERF_TLB is set, print the counts.
+     * @param buffer - the sender buffer, for its kind.
+     * @param nmsg   - messages sent, for the per message figure.
+     */
+    void report(std::ostream& out, const SendBuffer& buffer, size_t nmsg) {
+        if (!m_enabled) return;
+        out << "Sender buffer:       " << buffer.kind() << std::endl;
+        line(out, "dTLB load misses:    ", "dTLB load misses/msg:", m_loads, nmsg);
+        line(out, "dTLB store misses:   ", "dTLB store misses/msg:", m_stores, nmsg);
+    }
+
+private:
+    static int open(uint64_t result, uint64_t op) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size     = sizeof(attr);
+        attr.type     = PERF_TYPE_HW_CACHE;
+        attr.config   = PERF_COUNT_HW_CACHE_DTLB | (op << 8) | (result << 16);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;            // Allowed unprivileged at paranoid 2.
+        attr.exclude_hv     = 1;
+        int fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (fd < 0) {
+            std::cerr << "perf_event_open (dTLB) failed: " << strerror(errno) << std::endl;
+        }
+        return fd;
+    }
+    static void line(std::ostream& out, const char* total, const char* per, int fd, size_t nmsg) {
+        uint64_t count;
+        if (fd < 0 || read(fd, &count, sizeof(count)) != sizeof(count)) {
+            out << total << "unavailable" << std::endl;
+            return;
+        }
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        out << total << count << std::endl;
+        out << per << " " << (nmsg ? (double)count/nmsg : 0.0) << std::endl;
+    }
+
+    bool m_enabled;
+    int  m_loads;
+    int  m_stores;
+};
+
+#endif
@@ -0,0 +1,86 @@
+/**
+ * Multiple independent streams.
+ *
+ * pair, reqrep and pushpull normally measure one logical stream.  Given
+ * "streams M" they run M of them at once, each with its own sockets,
+ * threads and URI.  The URI is then a template with a %d that is
+ * replaced by the stream number, as bus does for its members, e.g.
+ *    pair tcp://localhost:400%d 100000 1024 streams 4
+ * uses tcp://localhost:4000 through tcp://localhost:4003.
+ *
+ * Every stream starts at the same time and notes when it finished.
+ * reportStreams prints one line per stream (its rate from the common
+ * start to its own end), the spread of those, and the aggregate: all
+ * the messages over the time until the last stream finished.  If nng's
+ * threads scale the aggregate grows with M while the per stream rate
+ * stays put; if they serialize the aggregate stays put.
+ */
+#ifndef STREAMS_H
+#define STREAMS_H
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+/**
+ * constructEndpoints
+ *  The URIs of the streams.
+ *
+ * @param base  - URI template with a %d for the stream number.
+ * @param size  - number of streams.
+ * @return std::vector<std::string> - the URIs in stream order.
+ */
+static inline std::vector<std::string>
+constructEndpoints(const char* base, size_t size) {
+    char endpoint[500];         // Should be big enough.
+    std::vector<std::string> result;
+
+    for (int i = 0; i < size; i++) {
+        snprintf(endpoint, sizeof(endpoint), base, i);
+        result.push_back(std::string(endpoint));
+    }
+    return result;
+}
+
+/**
+ * reportStreams
+ *   Report per stream and aggregate throughput.
+ *
+ * @param start - when all streams started.
+ * @param ends  - when each stream finished.
+ * @param nmsg  - messages in each stream.
+ * @param bytes - bytes in each stream.
+ */
+static inline void
+reportStreams(
+    std::chrono::high_resolution_clock::time_point start,
+    const std::vector<std::chrono::high_resolution_clock::time_point>& ends,
+    size_t nmsg, size_t bytes
+) {
+    std::vector<double> rates;
+    auto last = start;
+    for (int i = 0; i < ends.size(); i++) {
+        double timing = std::chrono::duration<double>(ends[i] - start).count();
+        rates.push_back((double)nmsg/timing);
+        std::cout << "Stream " << i << ": time " << timing
+                  << " msgs/sec " << rates.back()
+                  << " KB/sec " << (double)bytes/timing/1024.0 << std::endl;
+        last = std::max(last, ends[i]);
+    }
+    double sum = 0;
+    for (auto r : rates) sum += r;
+    std::cout << "Per stream msgs/sec min " << *std::min_element(rates.begin(), rates.end())
+              << " mean " << sum/rates.size()
+              << " max " << *std::max_element(rates.begin(), rates.end()) << std::endl;
+
+    double timing = std::chrono::duration<double>(last - start).count();
+    std::cout << "Aggregate over " << ends.size() << " streams\n";
+    std::cout << "Time:       " << timing << std::endl;
+    std::cout << "msgs/sec:   " << (double)(nmsg*ends.size())/timing << std::endl;
+    std::cout << "KB/sec:     " << (double)(bytes*ends.size())/timing/1024.0 << std::endl;
+}
+
+#endif
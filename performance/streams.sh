@@ -0,0 +1,46 @@
+#!/bin/bash
+
+# Aggregate scaling over independent streams (see streams.h): pair,
+# pushpull (one puller per stream) and reqrep (large requests) with 1, 2,
+# 4 ... streams up to the number of cores.  The table gives the
+# aggregate rate, the mean per stream rate and the scaling efficiency -
+# the aggregate over M times the one stream aggregate.  100% is perfect
+# scaling; falling towards 100/M% means the streams serialize.
+# Full output goes to streams.log.
+
+echo Streams log > streams.log
+
+cores=$(nproc)
+counts=""
+for (( m = 1; m < cores; m *= 2 )); do counts="$counts $m"; done
+counts="$counts $cores"
+
+run() {
+    tee -a streams.log | awk '
+	/^Per stream/ { if (!mean) mean = $(NF-2) }
+	/^msgs\/sec:/ { if (!agg) agg = $2 }
+	END { print agg, mean }'
+}
+
+printf "%-9s %8s %4s %14s %14s %6s\n" program size M aggregate per-stream "eff%"
+for size in 100 1024 65536
+do
+    nmsg=$(( size > 1024 ? 20000 : 100000 ))
+    for program in pair pushpull reqrep
+    do
+	one=""
+	for m in $counts
+	do
+	    echo ---- $program $size $m streams -------- >> streams.log
+	    case $program in
+		pair)     out=$(echo | ./pair tcp://127.0.0.1:41%03d $nmsg $size streams $m | run);;
+		pushpull) out=$(echo | ./pushpull tcp://127.0.0.1:42%03d $nmsg $size 1 streams $m | run);;
+		reqrep)   out=$(./reqrep tcp://127.0.0.1:43%03d $(( nmsg / 10 )) $size streams $m | run);;
+	    esac
+	    set -- $out
+	    if [ -z "$one" ]; then one=$1; fi
+	    printf "%-9s %8s %4s %14s %14s %6.1f\n" $program $size $m $1 $2 \
+		$(awk "BEGIN { print 100.0*$1/($m*$one) }")
+	done
+    done
+done
@@ -46,22 +46,10 @@
 #include <unistd.h>
 #include <vector>
 
-/**
- * checkstat
- *    Check the status of an nng call and output a message/exit
- * if the result is not ok.
- * 
- * @param status - nng status returned from a call.
- * @param doing  - text that will describe what failed.
- * 
- */
-static void 
-checkstat(int status,  const char* doing) {
-    if (status) {
-        std::cerr << doing << ": " << nng_strerror(status) << std::endl;
-        exit(EXIT_FAILURE);
-    }
-}
+#include "recvmode.h"
+#include "netns.h"
+#include "perfutil.h"
+
 
 /** Set RECVMAXSZ which, hopefully allows us to 
 * receive large responses.
@@ -98,6 +86,7 @@ responder(std::string uri, size_t nsurveys, size_t msgsize) {
     nng_socket s;
     void* pMsg;     // survey msg.
     size_t rcvSize; // Received size of survey.
+    perfReceiverSetup();
     
     // Setup to receive surveys.
 
@@ -117,7 +106,7 @@ responder(std::string uri, size_t nsurveys, size_t msgsize) {
         // accept survey:
 
         checkstat(
-            nng_recv(s, &pMsg, &rcvSize, NNG_FLAG_ALLOC),
+            perfRecv(s, &pMsg, &rcvSize),
             "Unable to get a survey."
         );
         nng_free(pMsg, rcvSize);
@@ -125,7 +114,7 @@ responder(std::string uri, size_t nsurveys, size_t msgsize) {
         // Send response:
 
         checkstat(
-            nng_send(s, reply, msgsize, 0),
+            tracedSend(s, reply, msgsize, 0),
             "Unable to respond to survey"
         );
     }
@@ -133,7 +122,7 @@ responder(std::string uri, size_t nsurveys, size_t msgsize) {
     // response.
 
     checkstat(
-        nng_recv(s, &pMsg, &rcvSize, NNG_FLAG_ALLOC),
+        perfRecv(s, &pMsg, &rcvSize),
         "Unable to get extra measure survey"
     );
     nng_close(s);                              // not gonna even respond.
@@ -152,14 +141,14 @@ responder(std::string uri, size_t nsurveys, size_t msgsize) {
 static void
 survey(nng_socket s, void* p, size_t size, size_t nresp)  {
     checkstat(
-        nng_send(s, p, size, 0), 
+        tracedSend(s, p, size, 0), 
         "Failed to send functional surveyt"
     );
     for (int i = 0; i < nresp; i++) {
         void* presponse;
         size_t rcvSize;
         checkstat(
-            nng_recv(s, &presponse, &rcvSize, NNG_FLAG_ALLOC),
+            perfRecv(s, &presponse, &rcvSize),
             "Failed to receive a functional response"
         );
     }
@@ -191,7 +180,7 @@ surveyor(nng_socket s, size_t nsurvey, size_t size, size_t nresp) {
     // do the extra survey (1 byte).
     // This signals the responder it can exit.
     checkstat(
-        nng_send(s, pMsg, 1, 0),
+        tracedSend(s, pMsg, 1, 0),
         "Unable to send ending survey"
     );
 }
@@ -217,7 +206,7 @@ int main(int argc, char** argv) {
     );
     setOptions(s, 0,0);                 // Unlimited.
     checkstat(
-        nng_listen(s, uri.c_str(), nullptr, 0),
+        perfListen(s, uri.c_str(), nullptr, 0),
         "Surveyor failed to start listening"
     );
     checkstat(
@@ -249,7 +238,7 @@ int main(int argc, char** argv) {
         "Failed to open second survey socket"
     );
     checkstat(
-        nng_listen(s, uri.c_str(), nullptr, 0),
+        perfListen(s, uri.c_str(), nullptr, 0),
         "Failed to start listening for second survey"
     );
     checkstat(
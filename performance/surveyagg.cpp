@@ -0,0 +1,243 @@
+/**
+ *  This program measures how fast survey responses can be consumed when
+ * they are printed one line each (surveyor.cpp's original path) versus
+ * when typed responses are folded into streaming reducers
+ * (SurveyAggregate in ../surveyvalue.h).
+ *
+ * Usage:
+ *    surveyagg uri nsurveys nresp
+ *
+ * Where
+ *    uri      - uri on which the surveyor listens.
+ *    nsurveys - Number of surveys in each timed phase.
+ *    nresp    - Number of respondents (thousands is the interesting case).
+ *
+ * Phases:
+ *   reducers only - nsurveys*nresp synthetic values are pushed through
+ *                   text formatting + printing (to /dev/null) and through
+ *                   SurveyAggregate::add with no communication at all.
+ *   text          - nresp respondent threads reply with their id as text;
+ *                   the surveyor prints each response (to /dev/null).
+ *   aggregate     - the respondents reply with a binary SurveyValue;
+ *                   the surveyor aggregates and prints one summary.
+ *
+ * As in survey.cpp every respondent answers every survey so each survey
+ * completes after nresp responses rather than on a timeout, and an extra
+ * survey tells the respondents to exit.
+ *
+ * Output is responses/sec (and surveys/sec for the communicating phases).
+ *
+ * @note this is not production quality code so missing parameters probably
+ * cause segfaults.
+ */
+#include <thread>
+#include <nng/nng.h>
+#include <nng/protocol/survey0/survey.h>
+#include <nng/protocol/survey0/respond.h>
+
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#include "recvmode.h"
+#include "netns.h"
+#include "../surveyvalue.h"
+#include "perfutil.h"
+
+
+/**
+ *  responder
+ *    Answer nsurveys surveys then wait for the extra one and exit.
+ *
+ * @param uri      - Uri of the serveyor.
+ * @param nsurveys - number of surveys to expect.
+ * @param id       - our id (reported in the response).
+ * @param binary   - true to respond with a SurveyValue, false for text.
+ */
+static void
+responder(std::string uri, size_t nsurveys, uint32_t id, bool binary) {
+    nng_socket s;
+    void* pMsg;
+    size_t rcvSize;
+    SurveyValue value;
+    char text[32];
+    perfReceiverSetup();
+
+    memset(&value, 0, sizeof(value));
+    value.magic = SURVEY_VALUE_MAGIC;
+    value.id    = id;
+    snprintf(text, sizeof(text), "%u", id);
+
+    checkstat(
+        nng_respondent0_open(&s), "Unable to open responder socket"
+    );
+    checkstat(
+        nng_dial(s, uri.c_str(), nullptr, 0),
+        "Unagle to dial into the survey "
+    );
+    for (int i=0; i < nsurveys; i++) {
+        checkstat(
+            perfRecv(s, &pMsg, &rcvSize),
+            "Unable to get a survey."
+        );
+        nng_free(pMsg, rcvSize);
+
+        if (binary) {
+            value.value = id + i;
+            checkstat(
+                tracedSend(s, &value, sizeof(value), 0),
+                "Unable to respond to survey"
+            );
+        } else {
+            checkstat(
+                tracedSend(s, text, strlen(text) + 1, 0),
+                "Unable to respond to survey"
+            );
+        }
+    }
+    checkstat(
+        perfRecv(s, &pMsg, &rcvSize),
+        "Unable to get extra measure survey"
+    );
+    nng_free(pMsg, rcvSize);
+    nng_close(s);
+}
+
+/**
+ * runSurveys
+ *    Start the respondents, run nsurveys surveys collecting nresp
+ *  responses each and report.
+ *
+ * @param uri      - uri to listen on.
+ * @param nsurveys - number of surveys.
+ * @param nresp    - number of respondents.
+ * @param binary   - binary responses which are aggregated, or text which
+ *                   are printed.
+ */
+static void
+runSurveys(const std::string& uri, size_t nsurveys, size_t nresp, bool binary) {
+    nng_socket s;
+    std::vector<std::thread*> threads;
+    std::ofstream sink("/dev/null");
+    SurveyAggregate aggregate;
+    char survey[] = "VALUE";
+
+    checkstat(
+        nng_surveyor0_open(&s),
+        "Failed to open survey socket."
+    );
+    checkstat(
+        perfListen(s, uri.c_str(), nullptr, 0),
+        "Surveyor failed to start listening"
+    );
+    checkstat(
+        nng_setopt_ms(s, NNG_OPT_SURVEYOR_SURVEYTIME, 8000),
+        "Failed to set survey max response time."
+    );
+    for (int i = 0; i < nresp; i++) {
+        threads.push_back(new std::thread(responder, uri, nsurveys, i, binary));
+    }
+    sleep(1 + nresp/1000);              // Let them all dial.
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < nsurveys; i++) {
+        checkstat(
+            tracedSend(s, survey, sizeof(survey), 0),
+            "Failed to send survey"
+        );
+        aggregate.reset();
+        for (int r = 0; r < nresp; r++) {
+            nng_msg* pMsg;
+            {
+                TraceScope trace("recv", traceNextRecv());
+                checkstat(
+                    nng_recvmsg(s, &pMsg, 0),
+                    "Failed to receive a response"
+                );
+            }
+            TraceScope trace("process");
+            if (binary) {
+                SurveyValue value;
+                memcpy(&value, nng_msg_body(pMsg), sizeof(value));
+                aggregate.add(value.id, value.value);
+            } else {
+                sink << "survey response: " << (const char*)(nng_msg_body(pMsg)) << std::endl;
+            }
+            nng_msg_free(pMsg);
+        }
+        if (binary) {
+            aggregate.print(sink);
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    checkstat(
+        tracedSend(s, survey, sizeof(survey), 0),
+        "Unable to send ending survey"
+    );
+    for (auto p : threads) {
+        p->join();
+        delete p;
+    }
+    nng_close(s);
+
+    double secs = (double)std::chrono::duration_cast<std::chrono::microseconds>(end - start).count()/1.0e6;
+    std::cout << (binary ? "Aggregated binary responses:\n" : "Printed text responses:\n");
+    std::cout << "Time           : " << secs << std::endl;
+    std::cout << "Surveys/sec    : " << nsurveys/secs << std::endl;
+    std::cout << "Responses/sec  : " << (double)(nsurveys*nresp)/secs << std::endl;
+}
+
+/**
+ * reducersOnly
+ *    Time printing vs aggregating nvalues values with no communication.
+ */
+static void
+reducersOnly(size_t nsurveys, size_t nresp) {
+    std::ofstream sink("/dev/null");
+    SurveyAggregate aggregate;
+    char text[32];
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < nsurveys; i++) {
+        for (int r = 0; r < nresp; r++) {
+            snprintf(text, sizeof(text), "%d", r);
+            sink << "survey response: " << text << std::endl;
+        }
+    }
+    auto mid = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < nsurveys; i++) {
+        aggregate.reset();
+        for (int r = 0; r < nresp; r++) {
+            aggregate.add(r, r + i);
+        }
+        aggregate.print(sink);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    double printSecs = (double)std::chrono::duration_cast<std::chrono::microseconds>(mid - start).count()/1.0e6;
+    double aggSecs   = (double)std::chrono::duration_cast<std::chrono::microseconds>(end - mid).count()/1.0e6;
+    double n = nsurveys * nresp;
+    std::cout << "Reducers only:\n";
+    std::cout << "Print values/sec     : " << n/printSecs << std::endl;
+    std::cout << "Aggregate values/sec : " << n/aggSecs << std::endl;
+}
+
+//  Entry point.
+//
+int main(int argc, char** argv) {
+    std::string uri(argv[1]);
+    size_t nsurveys = atoi(argv[2]);
+    size_t nresp = atoi(argv[3]);
+
+    reducersOnly(nsurveys, nresp);
+    runSurveys(uri, nsurveys, nresp, false);
+    runSurveys(uri, nsurveys, nresp, true);
+
+    return EXIT_SUCCESS;
+}
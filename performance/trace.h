@@ -0,0 +1,255 @@
+/**
+ * Low overhead tracing for the performance programs.
+ *
+ * Each thread records fixed size records - event name, start time,
+ * duration and a sequence number - into its own ring buffer.  Only the
+ * owning thread writes a ring so recording takes no locks or atomic
+ * read-modify-writes: two clock reads and a 32 byte store, a few tens of
+ * nanoseconds, cheap enough to leave on during sweeps.  When the ring
+ * fills the oldest records are overwritten.  At exit every ring is
+ * written out as a Chrome trace (load it in chrome://tracing or
+ * ui.perfetto.dev) with one track per thread.
+ *
+ * Trace points:
+ *   TraceScope t("name", seq) - records the lifetime of t.
+ *   tracedSend(s, ...)       - nng_send in a "send" scope.
+ *   tracedRecv(s, ...)       - nng_recv in a "recv" scope.
+ *   perfRecv (recvmode.h)    - traces itself as "recv".
+ * Without an explicit sequence number sends and receives are numbered
+ * per thread, so with one sender and one receiver the nth send and the
+ * nth receive are the same message.
+ *
+ * Environment:
+ *   PERF_TRACE=prefix      - enable; the trace goes to prefix.<pid>.json.
+ *   PERF_TRACE_RECORDS=n   - records kept per thread (default 65536,
+ *                            rounded up to a power of two).
+ * With PERF_TRACE unset a trace point costs one predictable branch.
+ *
+ * @note records of threads still running at exit may be mid-write when
+ *  they're dumped; join the threads first for a clean trace.
+ */
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <nng/nng.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+static const uint64_t TRACE_AUTO = UINT64_MAX;   // Number sends/recvs per thread.
+
+/**
+ *  One trace record.
+ */
+struct TraceRecord {
+    const char* name;                    // Static string.
+    uint64_t    start;                   // CLOCK_MONOTONIC ns.
+    uint64_t    duration;                // ns.
+    uint64_t    seq;
+};
+
+/**
+ *  A thread's ring of records.
+ */
+struct TraceRing {
+    pid_t                 tid;
+    size_t                mask;
+    TraceRecord*          records;
+    std::atomic<uint64_t> head;          // Records ever written.
+    uint64_t              sends;         // For TRACE_AUTO.
+    uint64_t              recvs;
+};
+
+/**
+ *  Process wide trace state.  Rings are never freed so the records of
+ * threads that have exited are still there to dump.
+ */
+struct TraceState {
+    bool                    enabled;
+    std::string             prefix;
+    size_t                  records;
+    std::mutex              lock;
+    std::vector<TraceRing*> rings;
+};
+
+static inline void traceDump();
+
+static inline TraceState&
+traceState() {
+    static TraceState* pState = [] {
+        TraceState* p = new TraceState;
+        const char* prefix = getenv("PERF_TRACE");
+        p->enabled = prefix != nullptr;
+        p->records = 65536;
+        if (prefix) {
+            p->prefix = prefix;
+            const char* records = getenv("PERF_TRACE_RECORDS");
+            size_t wanted = records ? strtoull(records, nullptr, 0) : 65536;
+            p->records = 1;
+            while (p->records < wanted) p->records <<= 1;
+            atexit(traceDump);
+        }
+        return p;
+    }();
+    return *pState;
+}
+
+/**
+ * traceEnabled
+ *   @return bool - true if PERF_TRACE is set.
+ */
+static inline bool
+traceEnabled() {
+    static const bool enabled = traceState().enabled;
+    return enabled;
+}
+
+static inline uint64_t
+traceNow() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+/**
+ * traceRing
+ *   @return TraceRing& - this thread's ring, made on first use.
+ */
+static inline TraceRing&
+traceRing() {
+    static thread_local TraceRing* pRing = nullptr;
+    if (!pRing) {
+        TraceState& state = traceState();
+        pRing = new TraceRing;
+        pRing->tid     = syscall(SYS_gettid);
+        pRing->mask    = state.records - 1;
+        pRing->records = new TraceRecord[state.records];
+        pRing->head    = 0;
+        pRing->sends   = 0;
+        pRing->recvs   = 0;
+        std::lock_guard<std::mutex> l(state.lock);
+        state.rings.push_back(pRing);
+    }
+    return *pRing;
+}
+
+/**
+ * traceRecord
+ *    Add a record to this thread's ring.
+ */
+static inline void
+traceRecord(const char* name, uint64_t start, uint64_t duration, uint64_t seq) {
+    TraceRing& ring = traceRing();
+    uint64_t head = ring.head.load(std::memory_order_relaxed);
+    TraceRecord& r = ring.records[head & ring.mask];
+    r.name     = name;
+    r.start    = start;
+    r.duration = duration;
+    r.seq      = seq;
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+/**
+ * TraceScope
+ *    Records its own lifetime as an event.
+ */
+class TraceScope {
+public:
+    TraceScope(const char* name, uint64_t seq = 0) :
+        m_name(name), m_seq(seq), m_start(traceEnabled() ? traceNow() : 0) {}
+    ~TraceScope() {
+        if (m_start) {
+            traceRecord(m_name, m_start, traceNow() - m_start, m_seq);
+        }
+    }
+    void seq(uint64_t seq) { m_seq = seq; }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+private:
+    const char* m_name;
+    uint64_t    m_seq;
+    uint64_t    m_start;
+};
+
+/**
+ * traceNextSend, traceNextRecv
+ *   @return uint64_t - this thread's next send/receive number.
+ */
+static inline uint64_t
+traceNextSend() {
+    return traceEnabled() ? traceRing().sends++ : 0;
+}
+static inline uint64_t
+traceNextRecv() {
+    return traceEnabled() ? traceRing().recvs++ : 0;
+}
+
+/**
+ * tracedSend
+ *    nng_send traced as "send".
+ */
+static inline int
+tracedSend(nng_socket s, void* pData, size_t size, int flags, uint64_t seq = TRACE_AUTO) {
+    TraceScope t("send", seq == TRACE_AUTO ? traceNextSend() : seq);
+    return nng_send(s, pData, size, flags);
+}
+
+/**
+ * tracedRecv
+ *    nng_recv traced as "recv".
+ */
+static inline int
+tracedRecv(nng_socket s, void* pData, size_t* pSize, int flags, uint64_t seq = TRACE_AUTO) {
+    TraceScope t("recv", seq == TRACE_AUTO ? traceNextRecv() : seq);
+    return nng_recv(s, pData, pSize, flags);
+}
+
+/**
+ * traceDump
+ *    Write every ring to prefix.<pid>.json as Chrome trace events
+ *  (complete events with times in microseconds).  Run at exit.
+ */
+static inline void
+traceDump() {
+    TraceState& state = traceState();
+    std::string filename = state.prefix + "." + std::to_string(getpid()) + ".json";
+    FILE* f = fopen(filename.c_str(), "w");
+    if (!f) {
+        perror("Unable to write the trace");
+        return;
+    }
+    pid_t pid = getpid();
+    const char* separator = "\n";
+    fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+    std::lock_guard<std::mutex> l(state.lock);
+    for (auto pRing : state.rings) {
+        fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+                "\"args\":{\"name\":\"thread %d\"}}",
+                separator, (int)pid, (int)pRing->tid, (int)pRing->tid);
+        separator = ",\n";
+
+        uint64_t head  = pRing->head.load(std::memory_order_acquire);
+        uint64_t first = head > pRing->mask + 1 ? head - (pRing->mask + 1) : 0;
+        for (uint64_t i = first; i < head; i++) {
+            const TraceRecord& r = pRing->records[i & pRing->mask];
+            fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+                    "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"seq\":%lu}}",
+                    separator, r.name, (int)pid, (int)pRing->tid,
+                    r.start/1000.0, r.duration/1000.0, (unsigned long)r.seq);
+        }
+    }
+    fprintf(f, "\n]}\n");
+    fclose(f);
+}
+
+#endif
@@ -0,0 +1,20 @@
+#!/bin/bash
+
+# Traces (see trace.h) of a few runs, for chrome://tracing or
+# ui.perfetto.dev.  Each run writes traces/<name>.<pid>.json; the bus
+# sweep is bustiming.sh with tracing left on.
+
+mkdir -p traces
+echo Trace log > trace.log
+
+echo ---- push/pull 4 pullers -------- >> trace.log
+echo | PERF_TRACE=traces/pushpull ./pushpull tcp://localhost:3000 100000 100 4 >> trace.log
+
+echo ---- req/rep -------- >> trace.log
+PERF_TRACE=traces/reqrep ./reqrep tcp://localhost:3001 100000 100 >> trace.log
+
+echo ---- open loop req 50000/sec -------- >> trace.log
+PERF_TRACE=traces/openloop ./openloop tcp://localhost:3002 req 4 50000 100000 100 poisson >> trace.log
+
+echo ---- bus sweep -------- >> trace.log
+PERF_TRACE=traces/bus PERF_TRACE_RECORDS=16384 ./bustiming.sh
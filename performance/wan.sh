@@ -0,0 +1,34 @@
+#!/bin/bash
+
+# The pattern benchmarks across an emulated WAN (netem.sh, needs root):
+# round trip times of 0, 1, 2 and 5 ms with 10% jitter, then 2 ms with
+# 0.1% loss and 2 ms on a 1gbit link.  reqrep, survey and pingpong
+# show the round trip cost; pushpull and pubsub whether the streaming
+# patterns keep the pipe full.
+
+URI=tcp://10.77.0.2
+export PERF_NETNS=nngwan
+
+echo WAN log > wan.log
+
+run() {
+    ./netem.sh up "$@" >> wan.log
+    for size in 100 65536
+    do
+	echo ---- size $size -------- >> wan.log
+	./reqrep $URI:3000 10000 $size >> wan.log
+	./survey $URI:3001 1000 $size 4 >> wan.log
+	./pingpong $URI:3002 10000 $size 100 >> wan.log
+	echo | ./pushpull $URI:3003 100000 $size 4 >> wan.log
+	echo | ./pubsub $URI:3004 100000 $size 4 >> wan.log
+    done
+}
+
+for delay in 0 0.5 1 2.5
+do
+    run $delay $(awk "BEGIN { print $delay/10 }")
+done
+run 1 0.1 0.1
+run 1 0.1 0 1gbit
+
+./netem.sh down
@@ -0,0 +1,320 @@
+/**
+ *  This program times a pull based (work stealing) dispatcher as an
+ * alternative to push/pull round robin distribution.
+ *   Usage:
+ *      workreq URI nmsgs size nworkers nslow fastus slowus budgetus [dist]
+ *
+ *   Where the parameters are the same as for pushload:
+ *     URI      - is the URI the dispatcher listens on.
+ *     nmsgs    - is the number of work items that will be handed out.
+ *     size     - is the size of each work item in bytes (at least 16).
+ *     nworkers - is the number of worker threads.
+ *     nslow    - is how many of those workers are slow (the first nslow).
+ *     fastus   - microseconds of synthetic work a fast worker does per item.
+ *     slowus   - microseconds of synthetic work a slow worker does per item.
+ *   and additionally:
+ *     budgetus - microseconds of work a worker is willing to take on per
+ *                request.  A worker advertises a capacity of
+ *                budgetus/its-work-per-item items (at least 1), so slow
+ *                workers ask for small batches and fast workers big ones.
+ *     dist     - fixed (default) or exp as for pushload.
+ *
+ *   The dispatcher is a REP socket; workers are REQ sockets.  A worker
+ *   only asks for work when it is idle so nothing ever queues behind a
+ *   slow worker:
+ *
+ *     request:  uint32_t capacity - most items the worker wants.
+ *     reply:    uint32_t count    - number of items that follow (0 means
+ *                                   no more work, the worker exits).
+ *               count items of size bytes each.
+ *
+ *   As in pushload each item carries, after the first 8 bytes, the steady
+ *   clock time (ns) at which the dispatcher handed it out and the workers
+ *   report end to end latency from that time.
+ *
+ *   Timing runs from the first dispatch to when all workers have been
+ *   told there's no more work and have been joined.  The output matches
+ *   pushload so the two can be compared directly (see balance.sh).
+ */
+#include <thread>
+#include <nng/nng.h>
+#include <nng/protocol/reqrep0/req.h>
+#include <nng/protocol/reqrep0/rep.h>
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#include "recvmode.h"
+#include "netns.h"
+#include "perfutil.h"
+
+
+/**
+ * spin
+ *    Burn CPU for the requested number of nanoseconds.
+ * @param ns - how long to spin.
+ */
+static void
+spin(uint64_t ns) {
+    uint64_t end = now() + ns;
+    while (now() < end)
+        ;
+}
+
+/**
+ *  Per worker results.  Each worker owns one of these so
+ *  there's no sharing until the join.
+ */
+struct WorkerStats {
+    bool                  slow;
+    size_t                count;
+    size_t                requests;
+    std::vector<uint64_t> latencies;      // ns.
+};
+
+/**
+ * worker
+ *    Dial the dispatcher and ask for work until told there is none.
+ *
+ * @param uri[in]     - The URI the dispatcher is listening on.
+ * @param workus      - Mean microseconds of work per item.
+ * @param capacity    - Items we ask for in each request.
+ * @param exponential - If true the work is exponentially distributed.
+ * @param seed        - Random number seed for the work distribution.
+ * @param pStats[out] - Where our statistics go.
+ */
+static void
+worker(
+    std::string uri, unsigned workus, uint32_t capacity, bool exponential,
+    unsigned seed, WorkerStats* pStats
+) {
+    nng_socket s;
+    std::mt19937_64 gen(seed);
+    std::exponential_distribution<double> dist(workus ? 1.0/workus : 1.0);
+
+    checkstat(
+        nng_req0_open(&s),
+        "Unable to open a worker socket."
+    );
+    checkstat(
+        nng_setopt_size(s, NNG_OPT_RECVMAXSZ, 0),  // Batches can be big.
+        "Unable to set worker RECVMAXSZ"
+    );
+    checkstat(
+        nng_dial(s, uri.c_str(), nullptr, 0),
+        "Worker dial failed"
+    );
+    while (true) {
+        nng_msg* pBatch;
+        uint32_t count;
+
+        checkstat(
+            tracedSend(s, &capacity, sizeof(capacity), 0),
+            "Worker could not ask for work"
+        );
+        {
+            TraceScope trace("recv", traceNextRecv());
+            checkstat(
+                nng_recvmsg(s, &pBatch, 0),
+                "Worker could not get a batch of work"
+            );
+        }
+        pStats->requests++;
+        uint8_t* p = reinterpret_cast<uint8_t*>(nng_msg_body(pBatch));
+        memcpy(&count, p, sizeof(count));
+        if (count == 0) {
+            nng_msg_free(pBatch);
+            break;
+        }
+        size_t itemSize = (nng_msg_len(pBatch) - sizeof(count))/count;
+        p += sizeof(count);
+
+        for (int i = 0; i < count; i++) {
+            TraceScope trace("process");
+            uint64_t sent;
+            memcpy(&sent, p + sizeof(uint64_t), sizeof(sent));
+
+            double us = exponential ? dist(gen) : workus;
+            spin(static_cast<uint64_t>(us * 1000.0));
+
+            pStats->latencies.push_back(now() - sent);
+            pStats->count++;
+            p += itemSize;
+        }
+        nng_msg_free(pBatch);
+    }
+    // Our last request got its reply so nothing is left in flight.
+
+    nng_close(s);
+}
+
+/**
+ * dispatcher
+ *    Hand out work in response to worker requests until all items are
+ *  given out and every worker has been told to stop.
+ *
+ * @param s        - listening REP socket.
+ * @param nmsg     - Number of work items.
+ * @param msgSize  - Size of each work item.
+ * @param nworkers - Number of workers that must be told to stop.
+ *
+ * @note the batch is formatted directly into the body of the reply
+ *       message so each reply costs one allocation.
+ */
+static void
+dispatcher(nng_socket s, size_t nmsg, size_t msgSize, size_t nworkers) {
+    size_t next = 0;
+    size_t stopped = 0;
+
+    while (stopped < nworkers) {
+        void*    pReq;
+        size_t   reqSize;
+        uint32_t capacity;
+
+        checkstat(
+            perfRecv(s, &pReq, &reqSize),
+            "Dispatcher could not get a request"
+        );
+        memcpy(&capacity, pReq, sizeof(capacity));
+        nng_free(pReq, reqSize);
+
+        TraceScope trace("process");
+        uint32_t count = std::min<size_t>(capacity, nmsg - next);
+        nng_msg* pBatch;
+        checkstat(
+            nng_msg_alloc(&pBatch, sizeof(count) + count*msgSize),
+            "Dispatcher could not allocate a batch"
+        );
+        uint8_t* p = reinterpret_cast<uint8_t*>(nng_msg_body(pBatch));
+        memcpy(p, &count, sizeof(count));
+        p += sizeof(count);
+        for (int i = 0; i < count; i++) {
+            uint64_t stamp = now();
+            memset(p, 0, sizeof(uint64_t));
+            memcpy(p + sizeof(uint64_t), &stamp, sizeof(stamp));
+            p += msgSize;
+        }
+        TraceScope sendTrace("send", traceNextSend());
+        checkstat(
+            nng_sendmsg(s, pBatch, 0),
+            "Dispatcher could not send a batch"
+        );
+        next += count;
+        if (count == 0) stopped++;
+    }
+}
+
+/**
+ *  Entry point:
+ *     - Set up the dispatcher listen.
+ *     - Spin off the workers, the first nslow of them slow.
+ *     - Time the dispatch and the joins.
+ *     - report.
+ *
+ * @note
+ *    This is not production code so segfaults will likely happen
+ * if paramteers are missing.  See Usage at the start of the file.
+ */
+int main(int argc, char** argv) {
+    std::string uri(argv[1]);
+    const size_t nmsg(atoi(argv[2]));
+    size_t msgSize(atoi(argv[3]));
+    const size_t nworkers(atoi(argv[4]));
+    const size_t nslow(atoi(argv[5]));
+    const unsigned fastus(atoi(argv[6]));
+    const unsigned slowus(atoi(argv[7]));
+    const unsigned budgetus(atoi(argv[8]));
+    bool exponential = (argc > 9) && (std::string(argv[9]) == "exp");
+    nng_socket s;
+    std::vector<std::thread*> workers;
+    std::vector<WorkerStats>  stats(nworkers);
+
+    if (msgSize < 2*sizeof(uint64_t)) {
+        msgSize = 2*sizeof(uint64_t);        // Room for the timestamp.
+    }
+    size_t maxBatch = 1;
+
+    checkstat(
+        nng_rep0_open(&s),
+        "Unable to create dispatcher socket."
+    );
+    checkstat(
+        perfListen(s, uri.c_str(), nullptr, 0),
+        "Unable to start dispatcher listening."
+    );
+    for (int i = 0; i < nworkers; i++) {
+        stats[i].slow     = i < nslow;
+        stats[i].count    = 0;
+        stats[i].requests = 0;
+        stats[i].latencies.reserve(nmsg);
+        unsigned workus   = stats[i].slow ? slowus : fastus;
+        uint32_t capacity = std::max(1u, budgetus/std::max(1u, workus));
+        maxBatch = std::max<size_t>(maxBatch, capacity);
+        workers.push_back(new std::thread(
+            worker, uri, workus, capacity, exponential, i+1, &stats[i]
+        ));
+    }
+    std::cout << "Enter to start timing:";
+    std::cout.flush();
+    std::cin.get();
+    std::cout <<  "Lets go\n";
+
+    auto start = std::chrono::high_resolution_clock::now();
+    dispatcher(s, nmsg, msgSize, nworkers);
+    for (auto p : workers) {
+        p->join();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    for (auto p : workers) {
+        delete p;
+    }
+    workers.clear();
+    nng_close(s);
+
+    // Totals:
+
+    auto duration  = end - start;
+    double timing = (double)std::chrono::duration_cast<std::chrono::milliseconds>(duration).count()/1000.0;
+    double msgTiming = (double)nmsg/timing;
+    double xferTiming = (double)(nmsg * msgSize)/timing;
+
+    std::cout << "Time:       " << timing << std::endl;
+    std::cout << "msgs/sec:   " << msgTiming << std::endl;
+    std::cout << "KB/sec:     " << xferTiming/1024.0 << std::endl;
+    std::cout << "Max batch:  " << maxBatch << std::endl;
+
+    // Per worker share and the merged latencies:
+
+    std::vector<uint64_t> all;
+    all.reserve(nmsg);
+    std::cout << "Puller  class  msgs        share%   mean-lat(us)  requests\n";
+    for (int i = 0; i < nworkers; i++) {
+        double sum = 0;
+        for (auto l : stats[i].latencies) sum += l;
+        double mean = stats[i].count ? sum/stats[i].count/1000.0 : 0.0;
+        std::cout << std::setw(6) << i << "  "
+                  << (stats[i].slow ? "slow " : "fast ") << "  "
+                  << std::setw(10) << stats[i].count << "  "
+                  << std::setw(7) << std::fixed << std::setprecision(2)
+                  << 100.0*stats[i].count/nmsg << "  "
+                  << std::setw(12) << mean << "  "
+                  << std::setw(8) << stats[i].requests << std::endl;
+        all.insert(all.end(), stats[i].latencies.begin(), stats[i].latencies.end());
+    }
+    std::sort(all.begin(), all.end());
+    std::cout << "Latency (us) p50:   " << percentile(all, 50.0) << std::endl;
+    std::cout << "Latency (us) p90:   " << percentile(all, 90.0) << std::endl;
+    std::cout << "Latency (us) p99:   " << percentile(all, 99.0) << std::endl;
+    std::cout << "Latency (us) p99.9: " << percentile(all, 99.9) << std::endl;
+    std::cout << "Latency (us) max:   " << (all.empty() ? 0.0 : all.back()/1000.0) << std::endl;
+
+    return EXIT_SUCCESS;
+}
@@ -7,99 +7,70 @@
 //  Subscribers can select what they want from these.
 // Usage:
 //    publiser uri
+//
+// With STATS_URI set, statistics (messages, bytes, time in send) are
+// published there once a second - see stats.h.
 
 #include <nng/nng.h>
 #include <nng/protocol/pubsub0/pub.h>
 
-#include <iostream>
 #include <stdlib.h>
-#include <sstream>
 #include <unistd.h>
 #include <time.h>
 
+#include "nngutil.h"
+#include "stats.h"
 
-// Check the status of an nng call and exit with message on failure
-static void 
-checkstat(int status,  const char* doing) {
-    if (status) {
-        std::cerr << doing << ": " << nng_strerror(status) << std::endl;
-        exit(EXIT_FAILURE);
-    }
-}
+using namespace nngutil;
 
-// send a string to our socket.
+// Send one message, counting it and the time the send took.
 
 static void
-send(nng_socket s, const std::string& msg) {
-    nng_msg* pMsg;
-    auto l = msg.size() + 1;
-
-    checkstat(
-        nng_msg_alloc(&pMsg, l),
-        "Failed to allocate message"
-    );
-    checkstat(
-        nng_msg_insert(pMsg, msg.c_str(), l),
-        "Failed to encapsulate message"
-    );
-    checkstat(
-        nng_sendmsg(s, pMsg, 0),
-        "Failed to send message"
-    );
-
-
+send(Socket& s, Stats& stats, Message&& msg) {
+    size_t len = msg.len();
+    uint64_t start = Stats::now();
+    s.send(std::move(msg));
+    stats.latency(Stats::now() - start);
+    stats.message(len);
 }
 
-// Publish our messages.
+// Publish our messages.  They are formatted straight into
+// the nng messages that are sent.
 
 static void 
-publish(nng_socket s, const char* name) {
+publish(Socket& s, MessageBuilder& builder, Stats& stats, const char* name) {
     // Name
 
-    std::stringstream namemsg;
-    namemsg << "NAME" << " " << name;
-    std::string namestr(namemsg.str());
-    send(s, namestr);
+    send(s, stats, builder.format("NAME %s", name));
 
     // PID
 
-    std::stringstream pidmsg;
-    pidmsg <<  "PID" << " " << getpid();
-    std::string pidstr(pidmsg.str());
-    send(s, pidstr);
+    send(s, stats, builder.format("PID %d", getpid()));
 
      //Timne.
 
      time_t t = time(nullptr);
      const char* time = ctime(&t);
 
-     std::stringstream timemsg;
-     timemsg << "TIME" << " " << time;
-     std::string timestr(timemsg.str());
-    send(s, timestr);
+    send(s, stats, builder.format("TIME %s", time));
 }
 
 
 int main(int argc,char** argv) {
-    nng_socket s;
     const char* uri = argv[1];
     const char* name = argv[0];
+    MessageBuilder builder;
+    Stats stats(name);
 
     // Open the socket and listen
 
-    checkstat(
-        nng_pub0_open(&s),
-        "Failed to open pub socket."
-    );
-    checkstat(
-        nng_listen(s, uri, nullptr, 0),
-        "Failed to start listner"
-    );
+    Socket s(nng_pub0_open, "Failed to open pub socket.");
+    s.listen(uri, "Failed to start listner");
 
     // every second, publish
 
     while (1) {
-        publish(s, name);
+        publish(s, builder, stats, name);
         sleep(2);
     }
 
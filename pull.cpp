@@ -6,6 +6,9 @@
 //
 // Where from is the URI of the pusher.
 //
+// With STATS_URI set, statistics (messages, bytes, time to handle each
+// message) are published there once a second - see stats.h.
+//
 // Note : this is demo code so no protection against from not supplied.
 
 
@@ -15,48 +18,36 @@
 #include <stdlib.h>
 #include <iostream>
 
+#include "nngutil.h"
+#include "stats.h"
 
-// Check the status of an nng call and exit with message on failure
-static void checkstat(int status,  const char* doing) {
-    if (status) {
-        std::cerr << doing << ": " << nng_strerror(status) << std::endl;
-        exit(EXIT_FAILURE);
-    }
-}
+using namespace nngutil;
 
 
 int main(int argc, char** argv) {
     auto uri = argv[1];                        // Better be there.
-    int status;
-    nng_socket s;
+    Stats stats(argv[0]);
 
     // Make the socket:
 
-    checkstat(
-        nng_pull0_open(&s), 
-        "Could not open the pull socket"
-    );
+    Socket s(nng_pull0_open, "Could not open the pull socket");
 
     //  Note!!!!!!  The example in https://nanomsg.org/gettingstarted/nng/pipeline.html
     // has the puller listening and pusher dialing.  I think that's
     // totally backwards from what makes sense.  This example will
     // try to turn that around to something sensible so we dial:
 
-    checkstat(
-        nng_dial(s, uri, nullptr, 0),
-        "Unable to dial the push program"
-    );
+    s.dial(uri, "Unable to dial the push program");
 
     // This loop gets messages from the pusher and outputs them
     // prefixed by our pid so, with mulitple pullers we know
     // who got the message:
 
     while (true) {
-        nng_msg* pmsg;
-        checkstat(
-            nng_recvmsg(s, &pmsg, 0), "Unable to receive mssage"
-        );
-        std::cerr << getpid() << " Received : " << (const char*)nng_msg_body(pmsg) << std::endl;
-        nng_msg_free(pmsg);
+        Message msg = s.recv("Unable to receive mssage");
+        uint64_t start = Stats::now();
+        std::cerr << getpid() << " Received : " << msg.str() << std::endl;
+        stats.latency(Stats::now() - start);
+        stats.message(msg.len());
     }
 }
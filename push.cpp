@@ -23,39 +23,29 @@
 //
 #include <nng/nng.h>
 #include <nng/protocol/pipeline0/push.h>
-#include <iostream>
-#include <sstream>
 #include <stdlib.h>
 #include <unistd.h>
 
+#include "nngutil.h"
 
-static const int MSG_COUNT(50);
+using namespace nngutil;
 
-// Check the status of an nng call and exit with message on failure
-static void checkstat(int status,  const char* doing) {
-    if (status) {
-        std::cerr << doing << ": " << nng_strerror(status) << std::endl;
-        exit(EXIT_FAILURE);
-    }
-}
+
+static const int MSG_COUNT(50);
 
 
 int main(int argc, char**argv) {
-    nng_socket s;
     const char* uri = argv[1];
+    MessageBuilder builder;
 
     // open the push socket.
 
-    checkstat(
-        nng_push0_open(&s),
-        "Failed to open push socket"
-    );
+    Socket s(nng_push0_open, "Failed to open push socket");
+
     // listen for connections
 
-    checkstat(
-        nng_listen(s, uri, nullptr, 0),
-        "Pusher coud not listen for socekt"
-    );
+    s.listen(uri, "Pusher coud not listen for socekt");
+
     // wait for at least one client:
 
     sleep(2);
@@ -63,28 +53,14 @@ int main(int argc, char**argv) {
     // Shoot messages:
 
     for ( int seq =0; seq < MSG_COUNT; seq++) {
-        // encode the message:
-
-        std::stringstream strmessage;
-        strmessage << "message number " << seq;
-        std::string message = strmessage.str();
-
-        //Encapsulate it in an nng_message
-
-        nng_msg* pmsg;
-        checkstat(
-            nng_msg_alloc(&pmsg, message.size()+1),
-            "Could not allocate a message struct"
-        );
-        checkstat(
-            nng_msg_insert(pmsg, message.c_str(), message.size() + 1),
-            "Could not append string to message"
-        );
-
+        // encode the message directly into an nng_message and
         // send it  - the sendmsg function takes ownerhisp of our
         // msg and frees it whent he send completes.
 
-        checkstat(nng_sendmsg(s, pmsg, 0), "Could not send message");
+        s.send(
+            builder.format("message number %d", seq),
+            "Could not send message"
+        );
     }
 
     // shoot the messages.
@@ -2,20 +2,37 @@
 // This pattern is a classical client server.
 // the client sends requests and the server replies to them.
 // The client cannot send additional requests until it has
-// read the reply.  This server does not attempt to handle
+// read the reply.  By default this server does not attempt to handle
 // more than one request at a time.
 //
 // usage:
-//    reply uri
+//    reply uri [ncontexts [nworkers]]
 // if URI is not supplied we'll probably segfault.
+//
+// If ncontexts is supplied and nonzero, the server instead runs ncontexts
+// nng_ctx contexts on the socket, each driven by an nng_aio callback.
+// Received requests are queued to a pool of nworkers threads (default 4)
+// that process them and start the reply send.  That way a slow request
+// only ties up one context/worker and the other clients are still served.
 
 // Requests supported:
 
 //   STOP -- reply OK and stop.
 //   DATE -- Reply OK <date string> and continue
 //   PID  -- Reply with OK <our pid> and continue.
+//   SLEEP ms -- Wait ms milliseconds then reply OK (a stand in for
+//           a slow request).
 //   anything else - Reply with ERROR - unrecognized request. and continue.
 //
+// The same requests can also be made with the binary protocol in
+// replyproto.h.  Binary requests are dispatched through a table indexed
+// by opcode and the reply is formatted in place in the request message,
+// which is then sent back, so they cost no allocation or string work.
+//
+// With STATS_URI set, statistics (requests, bytes, unrecognized requests
+// and the time from receiving a request to sending its reply) are
+// published there once a second - see stats.h.
+//
 #include <nng/nng.h>
 #include <nng/protocol/reqrep0/rep.h>
 #include <iostream>
@@ -24,46 +41,30 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <time.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
 
+#include "nngutil.h"
+#include "stats.h"
+#include "replyproto.h"
 
-// too useful will need to be in a lib if we do this later.
+using namespace nngutil;
 
-// Check the status of an nng call and exit with message on failure
-static void checkstat(int status,  const char* doing) {
-    if (status) {
-        std::cerr << doing << ": " << nng_strerror(status) << std::endl;
-        exit(EXIT_FAILURE);
-    }
-}
-// encapsulate a reply string in an nng_msg and send it to the client
+static Stats* pStats;               // Set up in main.
 
-static void
-send(nng_socket s, const std::string& msg) {
-    nng_msg* pmsg;
-    checkstat(
-        nng_msg_alloc(&pmsg, msg.size() + 1),
-        "Could not allocate reply message"
-    );
-    checkstat(
-        nng_msg_insert(pmsg, msg.c_str(), msg.size()+1),
-        "Failed to encapsualte reply message."
-    );
-    checkstat(
-        nng_sendmsg(s, pmsg, 0),
-        "Failed to send response."
-    );
-    // mng_sendmsg takes care of freeing pmsg.
-}
-
-// Process one request.
-static void
-processRequest(nng_socket s, std::string& req) {
+// Build the reply to one request.
+static std::string
+formatReply(const std::string& req) {
     std::string reply;
     if (req == "STOP") {
         reply = "OK";
     } else if (req == "DATE") {
         time_t t = time(nullptr);
-        char* dateTime = ctime(&t);
+        char dateTime[26];                  // ctime's buffer is shared by the workers.
+        ctime_r(&t, dateTime);
         std::stringstream message;
         message << "OK " << dateTime;
         reply  = message.str();
@@ -72,46 +73,232 @@ processRequest(nng_socket s, std::string& req) {
         std::stringstream message;
         message << "OK " << pid;
         reply = message.str();
+    } else if (req.compare(0, 6, "SLEEP ") == 0) {
+        usleep(atoi(req.c_str() + 6) * 1000);
+        reply = "OK";
     } else {
         reply = "ERROR - unrecognized request";
+        pStats->error();
     }
-    send(s, reply);
+    return reply;
+}
+
+// Process one request - the reply is built in a pooled message.
+static void
+processRequest(Socket& s, MessageBuilder& builder, std::string& req) {
+    s.send(builder.string(formatReply(req)), "Failed to send response.");
 
     if (req =="STOP")  {
         exit(EXIT_SUCCESS);
     }
 }
 
-int main(int argc, char** argv) {
-    nng_socket s;
-    const char* uri = argv[1];
-    // open the socket and listen on our uri:
-    checkstat(
-        nng_rep0_open(&s),
-        "Failed to open the reply socket."
-    );
-    // Listen on our URI:
+// Binary protocol handlers.  Each fills in the reply fields of the frame
+// and returns true if the server should stop once the reply is sent.
 
-    checkstat(
-        nng_listen(s, uri, nullptr, 0), 
-        "Failed to listen on URI"
-    );
+static bool
+binaryStop(ReplyFrame& frame) {
+    return true;
+}
+static bool
+binaryDate(ReplyFrame& frame) {
+    frame.value = time(nullptr);
+    return false;
+}
+static bool
+binaryPid(ReplyFrame& frame) {
+    frame.value = getpid();
+    return false;
+}
+static bool
+binarySleep(ReplyFrame& frame) {
+    usleep(frame.arg * 1000);
+    return false;
+}
 
-    // Process requests:
+typedef bool (*BinaryHandler)(ReplyFrame& frame);
+static const BinaryHandler binaryHandlers[OP_COUNT] = {
+    binaryStop,                // OP_STOP
+    binaryDate,                // OP_DATE
+    binaryPid,                 // OP_PID
+    binarySleep                // OP_SLEEP
+};
 
-    while (1) {
-        nng_msg* pmsg;
+// Turn the binary request in pmsg into its reply, in place.
+// Returns true if this was a STOP.
+static bool
+processBinary(nng_msg* pmsg) {
+    ReplyFrame* pFrame = reinterpret_cast<ReplyFrame*>(nng_msg_body(pmsg));
+    uint8_t op = pFrame->code;
+    bool stop = false;
+
+    pFrame->value = 0;
+    if (op < OP_COUNT) {
+        pFrame->code = STATUS_OK;
+        stop = binaryHandlers[op](*pFrame);
+    } else {
+        pFrame->code = STATUS_ERROR;
+        pStats->error();
+    }
+    return stop;
+}
+
+// The multi-context server.
+// Each context has a Work block whose aio callback moves it through
+// RECV (waiting for a request) -> queued to the worker pool -> SEND
+// (reply going out) -> RECV again.
+
+struct Work {
+    enum { RECV, SEND } state;
+    nng_aio* aio;
+    nng_ctx  ctx;
+    bool     stop;                  // Replying to STOP.
+    uint64_t received;              // When the request arrived.
+};
+
+static std::mutex              queueLock;
+static std::condition_variable queueCond;
+static std::deque<Work*>       workQueue;
+static bool                    stopRequested(false);
+
+// aio completion - runs in an nng thread so don't do the work here.
+static void
+workCallback(void* arg) {
+    Work* w = static_cast<Work*>(arg);
+    switch (w->state) {
+    case Work::RECV:
         checkstat(
-            nng_recvmsg(s, &pmsg, 0),
+            nng_aio_result(w->aio),
             "Failed to recieve a request"
         );
-        std::string request((const char*)nng_msg_body(pmsg));
-        processRequest(s, request);
+        w->received = Stats::now();
+        pStats->message(nng_msg_len(nng_aio_get_msg(w->aio)));
+        {
+            std::lock_guard<std::mutex> l(queueLock);
+            workQueue.push_back(w);
+        }
+        queueCond.notify_one();
+        break;
+    case Work::SEND:
+        checkstat(
+            nng_aio_result(w->aio),
+            "Failed to send response."
+        );
+        pStats->latency(Stats::now() - w->received);
+        if (w->stop) {
+            std::lock_guard<std::mutex> l(queueLock);
+            stopRequested = true;
+            queueCond.notify_all();
+            break;
+        }
+        w->state = Work::RECV;
+        nng_ctx_recv(w->ctx, w->aio);
+        break;
+    }
+}
+
+// Worker pool thread: process queued requests and start the reply.
+// The request message is reused to carry the reply.
+static void
+worker() {
+    while (1) {
+        Work* w;
+        {
+            std::unique_lock<std::mutex> l(queueLock);
+            queueCond.wait(l, [] { return !workQueue.empty(); });
+            w = workQueue.front();
+            workQueue.pop_front();
+        }
+        nng_msg* pmsg = nng_aio_get_msg(w->aio);
+        if (isReplyFrame(nng_msg_body(pmsg), nng_msg_len(pmsg))) {
+            w->stop = processBinary(pmsg);
+        } else {
+            std::string request((const char*)nng_msg_body(pmsg));
+            std::string reply = formatReply(request);
+            w->stop = request == "STOP";
 
-        nng_msg_free(pmsg);
+            nng_msg_clear(pmsg);
+            checkstat(
+                nng_msg_append(pmsg, reply.c_str(), reply.size() + 1),
+                "Failed to encapsualte reply message."
+            );
+        }
+        nng_aio_set_msg(w->aio, pmsg);
+        w->state = Work::SEND;
+        nng_ctx_send(w->ctx, w->aio);
     }
+}
 
+// Run the server with ncontexts contexts and nworkers threads.
+// Returns when a STOP reply has been sent.
+static void
+serveAsync(nng_socket s, int ncontexts, int nworkers) {
+    std::vector<Work*> contexts;
+    for (int i = 0; i < ncontexts; i++) {
+        Work* w = new Work;
+        w->state = Work::RECV;
+        w->stop  = false;
+        checkstat(
+            nng_aio_alloc(&w->aio, workCallback, w),
+            "Failed to allocate an aio"
+        );
+        checkstat(
+            nng_ctx_open(&w->ctx, s),
+            "Failed to open a context"
+        );
+        contexts.push_back(w);
+    }
+    for (int i = 0; i < nworkers; i++) {
+        std::thread(worker).detach();
+    }
+    for (auto w : contexts) {
+        nng_ctx_recv(w->ctx, w->aio);
+    }
 
+    std::unique_lock<std::mutex> l(queueLock);
+    queueCond.wait(l, [] { return stopRequested; });
 }
 
+int main(int argc, char** argv) {
+    const char* uri = argv[1];
+    int ncontexts = (argc > 2) ? atoi(argv[2]) : 0;
+    int nworkers  = (argc > 3) ? atoi(argv[3]) : 4;
+    MessageBuilder builder;
+    Stats stats(argv[0]);
+    pStats = &stats;
+
+    // open the socket and listen on our uri:
+    Socket s(nng_rep0_open, "Failed to open the reply socket.");
+
+    // Listen on our URI:
+
+    s.listen(uri, "Failed to listen on URI");
+
+    if (ncontexts > 0) {
+        serveAsync(s, ncontexts, nworkers);
+        exit(EXIT_SUCCESS);
+    }
+
+    // Process requests:
+
+    while (1) {
+        Message msg = s.recv("Failed to recieve a request");
+        uint64_t received = Stats::now();
+        stats.message(msg.len());
+        if (isReplyFrame(msg.body(), msg.len())) {
+            bool stop = processBinary(msg.get());
+            s.send(std::move(msg), "Failed to send response.");
+            stats.latency(Stats::now() - received);
+            if (stop) {
+                exit(EXIT_SUCCESS);
+            }
+            continue;
+        }
+        std::string request(msg.str());
+        builder.recycle(std::move(msg));     // Storage for the reply.
+        processRequest(s, builder, request);
+        stats.latency(Stats::now() - received);
+    }
 
+
+}
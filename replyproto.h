@@ -0,0 +1,67 @@
+// Binary request protocol understood by reply.cpp next to the text one.
+//
+// A binary request or reply is exactly one ReplyFrame.  Text requests are
+// printable ASCII so the magic first byte tells the server which protocol
+// a request uses; clients opt in just by sending frames.
+//
+// The reply is built by editing the request frame in place, so the server
+// sends back the very nng_msg it received - no allocation or formatting.
+//
+#ifndef REPLYPROTO_H
+#define REPLYPROTO_H
+
+#include <stdint.h>
+#include <string.h>
+
+static const uint8_t REPLY_FRAME_MAGIC(0xb1);
+
+// Request opcodes - these index the server's handler table.
+
+enum ReplyOpcode : uint8_t {
+    OP_STOP  = 0,
+    OP_DATE  = 1,
+    OP_PID   = 2,
+    OP_SLEEP = 3,              // arg is milliseconds.
+    OP_COUNT                   // Number of opcodes.
+};
+
+// Reply status codes.
+
+enum ReplyStatus : uint8_t {
+    STATUS_OK    = 0,
+    STATUS_ERROR = 1           // unrecognized request.
+};
+
+struct ReplyFrame {
+    uint8_t  magic;            // REPLY_FRAME_MAGIC
+    uint8_t  code;             // ReplyOpcode in requests, ReplyStatus in replies.
+    uint16_t unused;
+    uint32_t arg;              // Request argument.
+    uint64_t value;            // Reply value: time_t for DATE, pid for PID.
+};
+
+// Text names of the opcodes (used by req to build binary requests).
+
+static const char* replyOpcodeNames[OP_COUNT] = {
+    "STOP", "DATE", "PID", "SLEEP"
+};
+
+// Return the opcode for a request name or OP_COUNT if there is none.
+
+static inline uint8_t
+replyOpcode(const char* name) {
+    for (uint8_t i = 0; i < OP_COUNT; i++) {
+        if (strcmp(name, replyOpcodeNames[i]) == 0) return i;
+    }
+    return OP_COUNT;
+}
+
+// True if a message body holds a binary frame.
+
+static inline bool
+isReplyFrame(const void* body, size_t len) {
+    return (len == sizeof(ReplyFrame)) &&
+        (*static_cast<const uint8_t*>(body) == REPLY_FRAME_MAGIC);
+}
+
+#endif
@@ -1,9 +1,11 @@
 // sample nng REQ client
-// Usage:  req uri request
+// Usage:  req uri request [binary]
 //   WHen used with reply.cpp, request can be
-//      DATE, PID or STOP anything else gets an error reply.
+//      DATE, PID, "SLEEP ms" or STOP anything else gets an error reply.
 // We connect to the server at uri send our request and print the
 // ASCII reply we get back.
+//   If binary is given the request is sent using the binary protocol in
+// replyproto.h and the binary reply is decoded and printed.
 //
 // Test code so if either uri or request are missing probably we segfault
 
@@ -12,68 +14,75 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <string>
 #include <iostream>
 
-// too useful will need to be in a lib if we do this later.
+#include "nngutil.h"
+#include "replyproto.h"
 
-// Check the status of an nng call and exit with message on failure
-static void checkstat(int status,  const char* doing) {
-    if (status) {
-        std::cerr << doing << ": " << nng_strerror(status) << std::endl;
-        exit(EXIT_FAILURE);
-    }
-}
+using namespace nngutil;
 
 //
 // Make the request and get the reply.
 //
-static nng_msg*
-request(nng_socket s, const char* request) {
+static Message
+request(Socket& s, const char* request) {
     //
     // Format and send the request.
-    nng_msg* r;
-    size_t len = strlen(request) + 1;
-    checkstat(
-        nng_msg_alloc(&r, len),
-        "Failed to allocate request message"
-    );
-    checkstat(
-        nng_msg_insert(r, request, len),
-        "Failed to encapsualte request"
-    );
-    checkstat(
-        nng_sendmsg(s, r, 0),
-        "Failed to make request "
-    );
+    MessageBuilder builder;
+    s.send(builder.string(request), "Failed to make request ");
+
     // get the reply:
 
-    checkstat(
-        nng_recvmsg(s, &r, 0),
-        "Failed to get server response."
-    );
+    return s.recv("Failed to get server response.");
+}
+//
+// Make the request with the binary protocol and print the reply.
+//
+static void
+binaryRequest(Socket& s, const char* request) {
+    ReplyFrame frame;
+    std::string name(request);
+    auto space = name.find(' ');
+    MessageBuilder builder;
+
+    memset(&frame, 0, sizeof(frame));
+    frame.magic = REPLY_FRAME_MAGIC;
+    frame.code  = replyOpcode(name.substr(0, space).c_str());
+    if (space != std::string::npos) {
+        frame.arg = atoi(name.c_str() + space + 1);
+    }
+    s.send(builder.copy(&frame, sizeof(frame)), "Failed to make request ");
 
-    return r;
+    Message reply = s.recv("Failed to get server response.");
+    if (!isReplyFrame(reply.body(), reply.len())) {
+        std::cout << "Reply: not a binary reply\n";
+    } else {
+        memcpy(&frame, reply.body(), sizeof(frame));
+        if (frame.code == STATUS_OK) {
+            std::cout << "Reply: OK " << frame.value << std::endl;
+        } else {
+            std::cout << "Reply: ERROR - unrecognized request\n";
+        }
+    }
 }
 //
 int main(int argc, char** argv) {
-    nng_socket s;
     const char* uri = argv[1];
     const char* req = argv[2];
 
     // make the req socket and dial the server.
 
-    checkstat(
-        nng_req0_open(&s),
-        "Failed to  open the req0 socket"
-    );
-    checkstat(
-        nng_dial(s, uri, nullptr, 0),
-        "Failed to dial the server"
-    );
+    Socket s(nng_req0_open, "Failed to  open the req0 socket");
+    s.dial(uri, "Failed to dial the server");
 
-    nng_msg* reply = request(s, req);
-    std::cout << "Reply: " << (const char*)nng_msg_body(reply) << std::endl;
-    nng_msg_free(reply);
+    if (argc > 3 && strcmp(argv[3], "binary") == 0) {
+        binaryRequest(s, req);
+        exit(EXIT_SUCCESS);
+    }
+
+    Message reply = request(s, req);
+    std::cout << "Reply: " << reply.str() << std::endl;
 
     exit(EXIT_SUCCESS);
-}
\ No newline at end of file
+}
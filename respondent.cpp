@@ -4,6 +4,9 @@
 //   'ALL'  - I always respond.,
 //   'EVEN' - I respond if my pid is even (pid % 2 == 0).
 //   'ODD'  - I respond if my pid is odd (pid % 2 == 1).
+//   'VALUE' - I always respond with a binary SurveyValue (surveyvalue.h)
+//             holding my PID and my resident set size in KB (a stand in
+//             for e.g. a buffer occupancy).
 //
 // Usage:
 //  respndent surveyor
@@ -11,88 +14,49 @@
 #include <nng/nng.h>
 #include <nng/protocol/survey0/respond.h>   // We are the surveyer.
 
-#include <iostream>
 #include <stdlib.h>
-#include <sstream>
 #include <unistd.h>
-#include <time.h>
-#include <vector>
-#include <stdint.h>
+#include <string>
 #include <string.h>
+#include <fstream>
 
-// Check the status of an nng call and exit with message on failure
-static void 
-checkstat(int status,  const char* doing) {
-    if (status) {
-        std::cerr << doing << ": " << nng_strerror(status) << std::endl;
-        exit(EXIT_FAILURE);
-    }
-}
+#include "nngutil.h"
+#include "surveyvalue.h"
 
-// Get a string from a socket:
+using namespace nngutil;
 
-static std::string
-getmsg(nng_socket s) {
-     nng_msg* pMsg;
-     checkstat(
-        nng_recvmsg(s, &pMsg, 0),
-        "Failed to read a survey"
-     );
-     std::string result((const char*)(nng_msg_body(pMsg)));
-     nng_msg_free(pMsg);
+// Our resident set size in KB.
 
-     return result;
+static double
+residentKB() {
+    std::ifstream statm("/proc/self/statm");
+    unsigned long size = 0, resident = 0;
+    statm >> size >> resident;
+    return (double)resident * sysconf(_SC_PAGESIZE) / 1024.0;
 }
-// Send a message with our PID in it.
-static void
-reply(nng_socket s, pid_t pid) {
-    nng_msg* pMsg;
-    
-    // Stringify the pid.
-    
-    std::stringstream strmsg;
-    strmsg << pid;
-    std::string reply(strmsg.str());
-    auto len = reply.size() + 1;    // for null terminator.
-    checkstat(
-        nng_msg_alloc(&pMsg, len),
-        "Failed to alloctae reply msg."
-    );
-    checkstat(
-        nng_msg_insert(pMsg, reply.c_str(), len),
-        "Failed to encpasulate reply"
-    );
-
-    checkstat(
-        nng_sendmsg(s, pMsg, 0),
-        "Failed to reply to the server"
-    );
 
-}
 // entry point
 
 int main(int argc, char** argv) {
     const char* uri = argv[1];
-    nng_socket s;
+    MessageBuilder builder;
 
     // Open the responder socket:
 
-    checkstat(
-        nng_respondent0_open(&s),
-        "Failed to open a respondent socket"
-    );
+    Socket s(nng_respondent0_open, "Failed to open a respondent socket");
+
     // Dial the surveyor:
 
-    checkstat(
-        nng_dial(s, uri, nullptr, 0),
-        "Failed to dial the surveyor"
-    );
+    s.dial(uri, "Failed to dial the surveyor");
 
     pid_t me =  getpid();
     bool even = (me % 2) ==  0;
     while(1) {
         bool respond = false;
-        auto survey = getmsg(s);
+        Message msg = s.recv("Failed to read a survey");
+        std::string survey(msg.str(), msg.len());
+        if (!survey.empty() && survey.back() == '\0') survey.pop_back();
+        builder.recycle(std::move(msg));       // Its storage can carry a reply.
 
 
         // Determine if we should respond:
@@ -102,9 +66,18 @@ int main(int argc, char** argv) {
         else if ((survey == "ODD") && (!even)) respond = true;
 
 
+        // Send a message with our PID in it.
+
         if (respond) {
-            reply(s, me);
+            s.send(builder.format("%d", me), "Failed to reply to the server");
+        } else if (survey == "VALUE") {
+            SurveyValue value;
+            memset(&value, 0, sizeof(value));
+            value.magic = SURVEY_VALUE_MAGIC;
+            value.id    = me;
+            value.value = residentKB();
+            s.send(builder.copy(&value, sizeof(value)), "Failed to reply to the server");
         }
     }
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,154 @@
+// Live monitor for the statistics the example daemons publish when they
+// are run with STATS_URI set (see stats.h).
+// One sub socket dials every URI given and the latest statistics from
+// each process are shown as a table, redrawn once a second, so the
+// throughput through a whole chain of programs can be watched at once.
+//
+// Usage:
+//    statmon uri [uri...]
+//
+// Processes that haven't reported for 3 seconds are marked stale.  The
+// dials don't wait for the connection so programs can be started after
+// the monitor.
+//
+#include <nng/nng.h>
+#include <nng/protocol/pubsub0/sub.h>
+
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "nngutil.h"
+
+using namespace nngutil;
+
+static const nng_duration POLL(200);       // ms - recv timeout between redraws.
+static const time_t       STALE(3);        // s without a report.
+
+// What we know about one process.
+
+struct Process {
+    std::map<std::string, std::string> fields;
+    time_t                             lastSeen;
+};
+
+// Parse "STATS key=value key=value..." into fields.
+
+static std::map<std::string, std::string>
+parse(const char* text) {
+    std::map<std::string, std::string> fields;
+    std::istringstream in(text);
+    std::string item;
+    in >> item;                            // STATS
+    while (in >> item) {
+        size_t eq = item.find('=');
+        if (eq != std::string::npos) {
+            fields[item.substr(0, eq)] = item.substr(eq + 1);
+        }
+    }
+    return fields;
+}
+
+static double
+number(const Process& p, const char* key) {
+    auto i = p.fields.find(key);
+    return i == p.fields.end() ? 0.0 : atof(i->second.c_str());
+}
+
+// Clear the terminal and draw the table.
+
+static void
+draw(const std::map<std::string, Process>& processes) {
+    time_t now = time(nullptr);
+    double totalRate = 0, totalBytes = 0;
+
+    std::cout << "\033[H\033[2J";
+    std::cout << std::left << std::setw(20) << "NAME" << std::right
+              << std::setw(8)  << "PID"
+              << std::setw(11) << "MSG/S"
+              << std::setw(13) << "BYTES/S"
+              << std::setw(13) << "MSGS"
+              << std::setw(8)  << "ERRORS"
+              << std::setw(11) << "MEAN(us)"
+              << std::setw(11) << "P50(us)"
+              << std::setw(11) << "P99(us)"
+              << std::setw(11) << "MAX(us)" << std::endl;
+    for (auto& entry : processes) {
+        const Process& p = entry.second;
+        bool stale = now - p.lastSeen > STALE;
+        auto name = p.fields.find("name");
+        std::string shown = name == p.fields.end() ? "?" : name->second;
+        if (shown.size() > 19) shown = shown.substr(shown.size() - 19);
+        std::cout << std::left << std::setw(20) << shown << std::right
+                  << std::setw(8) << p.fields.at("pid")
+                  << std::fixed << std::setprecision(0)
+                  << std::setw(11) << number(p, "msg/s")
+                  << std::setw(13) << number(p, "bytes/s")
+                  << std::setw(13) << number(p, "msgs")
+                  << std::setw(8)  << number(p, "errors")
+                  << std::setprecision(1)
+                  << std::setw(11) << number(p, "lat_mean_us")
+                  << std::setw(11) << number(p, "lat_p50_us")
+                  << std::setw(11) << number(p, "lat_p99_us")
+                  << std::setw(11) << number(p, "lat_max_us");
+        if (stale) {
+            std::cout << "  stale " << now - p.lastSeen << "s";
+        } else {
+            totalRate  += number(p, "msg/s");
+            totalBytes += number(p, "bytes/s");
+        }
+        std::cout << std::endl;
+    }
+    std::cout << std::left << std::setw(28) << "TOTAL" << std::right
+              << std::setprecision(0)
+              << std::setw(11) << totalRate
+              << std::setw(13) << totalBytes << std::endl;
+}
+
+int main(int argc, char** argv) {
+    Socket s(nng_sub0_open, "Failed to open subscription socket");
+    checkstat(
+        nng_setopt(s, NNG_OPT_SUB_SUBSCRIBE, "STATS", 5),
+        "Failed to set subscription string"
+    );
+    checkstat(
+        nng_setopt_ms(s, NNG_OPT_RECVTIMEO, POLL),
+        "Failed to set the receive timeout."
+    );
+    for (int i = 1; i < argc; i++) {
+        checkstat(
+            nng_dial(s, argv[i], nullptr, NNG_FLAG_NONBLOCK),
+            "Failed to dial a statistics publisher"
+        );
+    }
+
+    // Keep the latest report of each process (by name and pid) and
+    // redraw each second.
+
+    std::map<std::string, Process> processes;
+    time_t lastDraw = 0;
+    while (true) {
+        Message msg;
+        int stat = s.recv(msg);
+        if (stat == 0) {
+            std::string text(msg.str(), strnlen(msg.str(), msg.len()));
+            Process p;
+            p.fields   = parse(text.c_str());
+            p.lastSeen = time(nullptr);
+            if (p.fields.count("pid")) {
+                processes[p.fields["name"] + ":" + p.fields["pid"]] = p;
+            }
+        } else if (stat != NNG_ETIMEDOUT) {
+            checkstat(stat, "Failed to receive statistics");
+        }
+        if (time(nullptr) != lastDraw) {
+            draw(processes);
+            lastDraw = time(nullptr);
+        }
+    }
+}
@@ -0,0 +1,162 @@
+// Implementation of the live statistics publisher - see stats.h
+
+#include "stats.h"
+#include "nngutil.h"
+
+#include <nng/protocol/pubsub0/pub.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace nngutil {
+
+static const uint64_t INTERVAL_NS(1000*1000*1000);     // Publish period.
+
+// name - what we call ourselves in the statistics (e.g. argv[0]).
+Stats::Stats(const char* name) :
+    m_name(name), m_enabled(false), m_running(false),
+    m_msgs(0), m_bytes(0), m_errors(0),
+    m_latencyCount(0), m_latencySum(0), m_latencyMax(0)
+{
+    for (int i = 0; i < BUCKETS; i++) {
+        m_histogram[i] = 0;
+    }
+    const char* uri = getenv("STATS_URI");
+    if (uri) {
+        checkstat(nng_pub0_open(&m_socket), "Failed to open the stats socket");
+        checkstat(
+            nng_listen(m_socket, uri, nullptr, 0),
+            "Failed to listen on STATS_URI"
+        );
+        m_enabled = true;
+        m_running = true;
+        m_thread  = std::thread(&Stats::publish, this);
+    }
+}
+
+Stats::~Stats() {
+    stop();
+}
+
+void
+Stats::message(size_t bytes) {
+    m_msgs.fetch_add(1, std::memory_order_relaxed);
+    m_bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void
+Stats::error() {
+    m_errors.fetch_add(1, std::memory_order_relaxed);
+}
+
+void
+Stats::latency(uint64_t ns) {
+    m_latencyCount.fetch_add(1, std::memory_order_relaxed);
+    m_latencySum.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t max = m_latencyMax.load(std::memory_order_relaxed);
+    while (ns > max && !m_latencyMax.compare_exchange_weak(max, ns))
+        ;
+    m_histogram[bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t
+Stats::now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+// Buckets 0-3 are exact; above that each power of two is split in four
+// by the two bits below the most significant one (~25% resolution).
+int
+Stats::bucket(uint64_t ns) {
+    if (ns < 4) return ns;
+    int msb = 63 - __builtin_clzll(ns);
+    return (msb - 1)*4 + ((ns >> (msb - 2)) & 3);
+}
+
+// Smallest value above bucket b.
+uint64_t
+Stats::bucketTop(int b) {
+    b++;
+    if (b < 4) return b;
+    if (b >= BUCKETS) return UINT64_MAX;
+    int msb = b/4 + 1;
+    return (uint64_t)(4 + b%4) << (msb - 2);
+}
+
+void
+Stats::stop() {
+    if (m_running) {
+        m_running = false;
+        m_thread.join();
+        nng_close(m_socket);
+    }
+}
+
+// The stats thread - publish once per interval.
+void
+Stats::publish() {
+    MessageBuilder builder(512, 2);
+    uint64_t lastMsgs = 0, lastBytes = 0;
+    uint64_t next = now();
+    pid_t pid = getpid();
+
+    while (m_running) {
+        next += INTERVAL_NS;
+        struct timespec t;
+        t.tv_sec  = next / 1000000000;
+        t.tv_nsec = next % 1000000000;
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, nullptr);
+
+        uint64_t msgs  = m_msgs;
+        uint64_t bytes = m_bytes;
+        uint64_t count = m_latencyCount.exchange(0);
+        uint64_t sum   = m_latencySum.exchange(0);
+        uint64_t max   = m_latencyMax.exchange(0);
+        uint64_t histogram[BUCKETS];
+        uint64_t inHistogram = 0;
+        for (int i = 0; i < BUCKETS; i++) {
+            histogram[i] = m_histogram[i].exchange(0);
+            inHistogram += histogram[i];
+        }
+
+        // p50/p99 as the top of the bucket they fall in.
+
+        double p50 = 0, p99 = 0;
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKETS && inHistogram; i++) {
+            uint64_t before = seen;
+            seen += histogram[i];
+            if (before < inHistogram*50/100 + 1 && seen >= inHistogram*50/100 + 1) {
+                p50 = bucketTop(i)/1000.0;
+            }
+            if (before < inHistogram*99/100 + 1 && seen >= inHistogram*99/100 + 1) {
+                p99 = bucketTop(i)/1000.0;
+            }
+        }
+        if (p50 > max/1000.0) p50 = max/1000.0;
+        if (p99 > max/1000.0) p99 = max/1000.0;
+
+        Message msg = builder.format(
+            "STATS name=%s pid=%d msgs=%lu bytes=%lu msg/s=%lu bytes/s=%lu errors=%lu "
+            "lat_n=%lu lat_mean_us=%.1f lat_p50_us=%.1f lat_p99_us=%.1f lat_max_us=%.1f",
+            m_name.c_str(), (int)pid,
+            (unsigned long)msgs, (unsigned long)bytes,
+            (unsigned long)(msgs - lastMsgs), (unsigned long)(bytes - lastBytes),
+            (unsigned long)m_errors.load(), (unsigned long)count,
+            count ? sum/1000.0/count : 0.0, p50, p99, max/1000.0
+        );
+        nng_msg* pMsg = msg.release();
+        if (nng_sendmsg(m_socket, pMsg, 0)) {
+            nng_msg_free(pMsg);
+        }
+        lastMsgs  = msgs;
+        lastBytes = bytes;
+    }
+}
+
+}                    // namespace nngutil
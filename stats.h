@@ -0,0 +1,69 @@
+// Live statistics for the example daemons.
+//
+// A Stats object counts the messages, bytes and errors a program handles
+// and keeps a latency histogram.  If the STATS_URI environment variable
+// is set, a thread listens there with a pub0 socket and once a second
+// publishes one line:
+//
+//   STATS name=<argv[0]> pid=<pid> msgs=<total> bytes=<total>
+//         msg/s=<rate> bytes/s=<rate> errors=<total> lat_n=<count>
+//         lat_mean_us=.. lat_p50_us=.. lat_p99_us=.. lat_max_us=..
+//
+// The rates and latencies are for the last second.  Subscribe to
+// "STATS" with subscriber, or watch many programs with statmon.  With
+// STATS_URI unset the counting is still done but nothing is published.
+//
+#ifndef STATS_H
+#define STATS_H
+
+#include <nng/nng.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <thread>
+
+namespace nngutil {
+
+class Stats {
+public:
+    explicit Stats(const char* name);
+    ~Stats();
+
+    Stats(const Stats&) = delete;
+    Stats& operator=(const Stats&) = delete;
+
+    bool enabled() const { return m_enabled; }
+
+    void message(size_t bytes);            // One message handled.
+    void error();                          // One thing went wrong.
+    void latency(uint64_t ns);             // Time taken by one message.
+
+    static uint64_t now();                 // CLOCK_MONOTONIC ns for latency().
+
+private:
+    static const int BUCKETS = 252;        // 4 per power of two up to 2^64 ns.
+    static int bucket(uint64_t ns);
+    static uint64_t bucketTop(int b);
+
+    void publish();
+    void stop();
+
+    std::string           m_name;
+    bool                  m_enabled;
+    nng_socket            m_socket;
+    std::thread           m_thread;
+    std::atomic<bool>     m_running;
+
+    std::atomic<uint64_t> m_msgs;
+    std::atomic<uint64_t> m_bytes;
+    std::atomic<uint64_t> m_errors;
+    std::atomic<uint64_t> m_latencyCount;  // Since the last publication.
+    std::atomic<uint64_t> m_latencySum;
+    std::atomic<uint64_t> m_latencyMax;
+    std::atomic<uint64_t> m_histogram[BUCKETS];
+};
+
+}                    // namespace nngutil
+
+#endif
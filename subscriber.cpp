@@ -14,31 +14,18 @@
 #include <time.h>
 #include <string.h>
 
+#include "nngutil.h"
 
-// Check the status of an nng call and exit with message on failure
-static void 
-checkstat(int status,  const char* doing) {
-    if (status) {
-        std::cerr << doing << ": " << nng_strerror(status) << std::endl;
-        exit(EXIT_FAILURE);
-    }
-}
+using namespace nngutil;
 
 int main(int argc, char** argv) {
-    nng_socket s;
     const char* uri = argv[1];
     const char* subscription = argv[2];
 
 
     // Dial up the server.
-    checkstat(
-        nng_sub0_open(&s),
-        "Failed to open subscription socket"
-    );
-    checkstat(
-        nng_dial(s, uri, nullptr, 0),
-        "Failed to dial the publisher."
-    );
+    Socket s(nng_sub0_open, "Failed to open subscription socket");
+    s.dial(uri, "Failed to dial the publisher.");
     
 
     // set our subscription.
@@ -53,15 +40,8 @@ int main(int argc, char** argv) {
     // get and print what we got:
 
     while (true) {
-        nng_msg* pMsg;
-
-        checkstat(
-            nng_recvmsg(s, &pMsg, 0),
-            "Failed to receive from publisher"
-        );
-        std::cout << getpid() << " Got " << (const char*)nng_msg_body(pMsg) << std::endl;
-
-        nng_msg_free(pMsg);
+        Message msg = s.recv("Failed to receive from publisher");
+        std::cout << getpid() << " Got " << msg.str() << std::endl;
     }
 }
 
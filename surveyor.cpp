@@ -7,18 +7,47 @@
 //    ALL - everyone resonds - with their PID.
 //    EVEN - only even pids respond with their PID
 //    ODD  - Only odd pids respond with their PID.
+//
+// Surveys everyone answers (ALL and VALUE) end as soon as all of the
+// respondents connected when we check have answered, rather than waiting
+// out the lifetime.  We track the connected respondents with
+// nng_pipe_notify.  The lifetime is still the deadline, e.g. if someone
+// doesn't answer, and is the only way EVEN and ODD surveys end since we
+// can't know who will answer those.
+//
+// Usage:
+//    surveyor uri [aggregate] [quorum=percent]
+//
+//  quorum=percent ends ALL/VALUE surveys once that percentage of the
+//  connected respondents have answered (default 100).
+//
+//  With aggregate, we instead send VALUE surveys.  Respondents answer those
+//  with a binary SurveyValue (see surveyvalue.h) which we fold into
+//  streaming reducers (count, sum, min/max, histogram, top-k) rather than
+//  printing.  One summary is printed per survey.  Text responses are
+//  aggregated as numbers too so older respondents still count.
+//
+//  With STATS_URI set, statistics (responses, bytes, surveys everyone
+//  should have answered that ended short, and the time from the survey to
+//  each response) are published there once a second - see stats.h.
 //   
 #include <nng/nng.h>
 #include <nng/protocol/survey0/survey.h>   // We are the surveyer.
 
 #include <iostream>
 #include <stdlib.h>
-#include <sstream>
 #include <unistd.h>
-#include <time.h>
 #include <vector>
-#include <stdint.h>
 #include <string.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+#include "nngutil.h"
+#include "stats.h"
+#include "surveyvalue.h"
+
+using namespace nngutil;
 
 std::vector<const char*> surveys = {
     "ALL", "EVEN", "ODD"
@@ -26,81 +55,135 @@ std::vector<const char*> surveys = {
 
 
 static const nng_duration LIFETIME(2*1000);     // UNits of ms.
+static const nng_duration POLL(100);            // recv timeout - so we notice departures.
+
+static std::atomic<int> liveRespondents(0);
+static int              quorumPercent(100);
+static Stats*           pStats;                 // Set up in main.
 
-// Check the status of an nng call and exit with message on failure
-static void 
-checkstat(int status,  const char* doing) {
-    if (status) {
-        std::cerr << doing << ": " << nng_strerror(status) << std::endl;
-        exit(EXIT_FAILURE);
+// Pipe notification - keeps track of the connected respondents.
+
+static void
+pipeEvent(nng_pipe p, nng_pipe_ev ev, void* arg) {
+    if (ev == NNG_PIPE_EV_ADD_POST) {
+        liveRespondents++;
+    } else if (ev == NNG_PIPE_EV_REM_POST) {
+        liveRespondents--;
     }
 }
-// Send a string to a socket.
 
-static void
-send(nng_socket s , const char* msg) {
-    nng_msg *pMsg; 
-    auto l = strlen(msg);
+// Responses that complete a survey everyone answers.
 
-    checkstat(
-        nng_msg_alloc(&pMsg, l),
-        "Failed to allocate a message block."
-    );
-    checkstat(
-        nng_msg_insert(pMsg, msg, l),
-        "Failed to encapsulate a send message"
-    );
-    checkstat(
-        nng_sendmsg(s, pMsg, 0),
-        "Failed to send a survey message."
-    );
+static int
+expectedResponses() {
+    int live = liveRespondents;
+    return (live*quorumPercent + 99)/100;
 }
 
+// Collect the responses to the survey just sent, passing each to handle.
+// If everyone should answer we stop once the expected number have,
+// otherwise (and as the fallback) when the lifetime is up.
+// Returns the number of responses.
+
 static int
-receiveAndPrint(nng_socket s) {
-    nng_msg* pmsg;
-    int status;
+collect(Socket& s, bool everyone, const std::function<void(Message&)>& handle) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(LIFETIME);
+    uint64_t sent = Stats::now();
+    int responses = 0;
+    while (!(everyone && (responses >= expectedResponses()))) {
+        Message msg;
+        int stat = s.recv(msg);
+        if (stat == 0) {
+            pStats->latency(Stats::now() - sent);
+            pStats->message(msg.len());
+            handle(msg);
+            responses++;
+        } else if (stat == NNG_ETIMEDOUT) {
+            if (std::chrono::steady_clock::now() >= deadline) break;
+        } else if (stat == NNG_ESTATE) {
+            break;                     // The survey expired.
+        } else {
+            checkstat(stat, "Suvey response failure");
+        }
+    }
+    if (everyone && (responses < expectedResponses())) {
+        pStats->error();               // Someone didn't answer in time.
+    }
+    return responses;
+}
 
-    status = nng_recvmsg(s, &pmsg, 0);
-    if (status == 0) {
-        std::cout << "survey response: " << (const char*)(nng_msg_body(pmsg)) << std::endl;
+// Print a response:
 
-        nng_msg_free(pmsg);
-    } 
-    return status;
+static void
+print(Message& msg) {
+    std::cout << "survey response: " << msg.str() << std::endl;
 }
 
-// Recieve and print a string from a socket:
-
-// Survey - conduct a survey getting responses for the whole life of the survey:
+// Fold a response into the aggregate:
 
 static void
-survey(nng_socket s, const char* survey) {
-    std::cout << "Surveying " << survey << std::endl;
-    send(s, survey);       // Send the survey msg.
-    int stat;
-    while ((stat = receiveAndPrint(s)) == 0 ) 
-        ;
-    if (stat != NNG_ETIMEDOUT ) {
-        checkstat(stat, "Suvey response failure");
+fold(SurveyAggregate& aggregate, Message& msg) {
+    if (isSurveyValue(msg.body(), msg.len())) {
+        SurveyValue value;
+        memcpy(&value, msg.body(), sizeof(value));
+        aggregate.add(value.id, value.value);
+    } else {
+        std::string text(msg.str(), strnlen(msg.str(), msg.len()));
+        aggregate.add(0, atof(text.c_str()));
     }
-    // timed out is a normal completion.
+}
+
+// Survey - conduct a survey getting responses until complete:
+
+static int
+survey(Socket& s, MessageBuilder& builder, const char* survey) {
+    std::cout << "Surveying " << survey << std::endl;
+    s.send(builder.string(survey), "Failed to send a survey message.");
+    return collect(s, strcmp(survey, "ALL") == 0, print);
+}
+
+// Aggregated survey - as above but the responses are reduced and
+// a single summary is output.
+
+static int
+aggregateSurvey(Socket& s, MessageBuilder& builder, SurveyAggregate& aggregate) {
+    std::cout << "Surveying VALUE" << std::endl;
+    aggregate.reset();
+    s.send(builder.string("VALUE"), "Failed to send a survey message.");
+    int responses = collect(
+        s, true, [&aggregate](Message& msg) { fold(aggregate, msg); }
+    );
+    aggregate.print(std::cout);
+    return responses;
 }
 
 int main(int argc, char** argv) {
-    nng_socket s;
     const char* uri = argv[1];
+    bool aggregated = false;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "aggregate") == 0) {
+            aggregated = true;
+        } else if (strncmp(argv[i], "quorum=", 7) == 0) {
+            quorumPercent = atoi(argv[i] + 7);
+        }
+    }
+    MessageBuilder builder;
+    SurveyAggregate aggregate;
+    Stats stats(argv[0]);
+    pStats = &stats;
 
     // create the survey socket and listen on the URI
 
+    Socket s(nng_surveyor0_open, "Failed to create the surveyor socket");
     checkstat(
-        nng_surveyor0_open(&s),
-        "Failed to create the surveyor socket"
+        nng_pipe_notify(s, NNG_PIPE_EV_ADD_POST, pipeEvent, nullptr),
+        "Failed to register for pipe additions"
     );
     checkstat(
-        nng_listen(s, uri, nullptr, 0),
-        "Failed to listen on the survey"
+        nng_pipe_notify(s, NNG_PIPE_EV_REM_POST, pipeEvent, nullptr),
+        "Failed to register for pipe removals"
     );
+    s.listen(uri, "Failed to listen on the survey");
 
     // Set the survey lifetime.
 
@@ -108,15 +191,29 @@ int main(int argc, char** argv) {
         nng_setopt_ms(s, NNG_OPT_SURVEYOR_SURVEYTIME, LIFETIME),
         "Failed to set survey max response time."
     );
+    checkstat(
+        nng_setopt_ms(s, NNG_OPT_RECVTIMEO, POLL),
+        "Failed to set the receive timeout."
+    );
 
     // Survey and report responses.
 
     for (int i =0; true; i++) {    // kinda cool
         sleep(5);
-        int index = i % surveys.size();    // choose the survey:
-
-        survey(s, surveys[index]);
-        std::cerr << "Survey done\n";
+        auto start = std::chrono::steady_clock::now();
+        int responses;
+        if (aggregated) {
+            responses = aggregateSurvey(s, builder, aggregate);
+        } else {
+            int index = i % surveys.size();    // choose the survey:
+
+            responses = survey(s, builder, surveys[index]);
+        }
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start
+        ).count();
+        std::cerr << "Survey done in " << ms << " ms: " << responses
+                  << " responses, " << liveRespondents << " respondents connected\n";
     }
 }
 
@@ -0,0 +1,141 @@
+// Typed survey responses and streaming aggregation of them.
+//
+// A respondent answering a VALUE survey sends one SurveyValue: its id
+// (we use the PID) and a number (e.g. a buffer occupancy).  The
+// surveyor feeds each response into a SurveyAggregate which keeps
+// count, sum, min/max, a log2 histogram and the top k values in
+// constant space, so a survey yields one summary however many
+// respondents there are.
+//
+#ifndef SURVEYVALUE_H
+#define SURVEYVALUE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <queue>
+#include <utility>
+#include <vector>
+
+static const uint8_t SURVEY_VALUE_MAGIC(0x5a);
+
+struct SurveyValue {
+    uint8_t  magic;            // SURVEY_VALUE_MAGIC
+    uint8_t  unused[3];
+    uint32_t id;               // Who is responding.
+    double   value;            // What they report.
+};
+
+// True if a message body holds a SurveyValue.
+
+static inline bool
+isSurveyValue(const void* body, size_t len) {
+    return (len == sizeof(SurveyValue)) &&
+        (*static_cast<const uint8_t*>(body) == SURVEY_VALUE_MAGIC);
+}
+
+/**
+ * SurveyAggregate
+ *    Streaming reducers over the responses to one survey.
+ */
+class SurveyAggregate {
+public:
+    static const int HISTOGRAM_BINS = 65;   // <1, [1,2), [2,4) ... [2^63, inf)
+
+    explicit SurveyAggregate(size_t k = 5) : m_k(k) { reset(); }
+
+    // Start a new survey.
+
+    void reset() {
+        m_count = 0;
+        m_sum   = 0.0;
+        m_min   = std::numeric_limits<double>::max();
+        m_max   = std::numeric_limits<double>::lowest();
+        std::fill(m_histogram, m_histogram + HISTOGRAM_BINS, 0);
+        m_top   = TopHeap();
+    }
+
+    // Fold one response in.
+
+    void add(uint32_t id, double value) {
+        m_count++;
+        m_sum += value;
+        m_min  = std::min(m_min, value);
+        m_max  = std::max(m_max, value);
+        m_histogram[bin(value)]++;
+
+        if (m_top.size() < m_k) {
+            m_top.push(std::make_pair(value, id));
+        } else if (m_k && (value > m_top.top().first)) {
+            m_top.pop();
+            m_top.push(std::make_pair(value, id));
+        }
+    }
+
+    size_t count() const { return m_count; }
+    double sum()   const { return m_sum; }
+    double min()   const { return m_min; }
+    double max()   const { return m_max; }
+    double mean()  const { return m_count ? m_sum/m_count : 0.0; }
+    const size_t* histogram() const { return m_histogram; }
+
+    // The top k (value, id) pairs, largest first.
+
+    std::vector<std::pair<double, uint32_t>> top() const {
+        TopHeap copy(m_top);
+        std::vector<std::pair<double, uint32_t>> result;
+        while (!copy.empty()) {
+            result.push_back(copy.top());
+            copy.pop();
+        }
+        std::reverse(result.begin(), result.end());
+        return result;
+    }
+
+    // Write the summary.
+
+    void print(std::ostream& out) const {
+        out << "count: " << m_count;
+        if (m_count) {
+            out << " sum: " << m_sum << " mean: " << mean()
+                << " min: " << m_min << " max: " << m_max;
+        }
+        out << std::endl;
+        out << "histogram (log2 bins):";
+        for (int i = 0; i < HISTOGRAM_BINS; i++) {
+            if (m_histogram[i]) {
+                out << " [" << (i ? ldexp(1.0, i - 1) : 0.0) << "]=" << m_histogram[i];
+            }
+        }
+        out << std::endl;
+        out << "top " << m_k << ":";
+        for (auto& v : top()) {
+            out << " " << v.second << "=" << v.first;
+        }
+        out << std::endl;
+    }
+
+private:
+    typedef std::pair<double, uint32_t> Entry;
+    typedef std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> TopHeap;
+
+    static int bin(double value) {
+        if (!(value >= 1.0)) return 0;           // Also catches NaN.
+        int b = ilogb(value) + 1;
+        return b < HISTOGRAM_BINS ? b : HISTOGRAM_BINS - 1;
+    }
+
+    size_t  m_k;
+    size_t  m_count;
+    double  m_sum;
+    double  m_min;
+    double  m_max;
+    size_t  m_histogram[HISTOGRAM_BINS];
+    TopHeap m_top;
+};
+
+#endif